@@ -0,0 +1,111 @@
+// Compare repo.json ingestion paths:
+//   stream  - std::ifstream >> nlohmann::json, as fox did originally
+//   stage1  - structural scan only, over an already-mapped file
+//   scan    - mmap + structural scan + typed records (load_repo_records)
+//
+// Usage: bench_ingest <repo.json> [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "repo_scan.hpp"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double run(const char* label, int iterations, std::size_t bytes, const std::function<void()>& body) {
+    std::vector<double> samples;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        body();
+        samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    double best = samples.front();
+    double median = samples[samples.size() / 2];
+    std::cout << std::left << std::setw(8) << label << std::right << std::fixed << std::setprecision(2)
+              << " best " << std::setw(9) << best << " ms"
+              << "  median " << std::setw(9) << median << " ms"
+              << "  " << std::setw(8) << (bytes / 1e6) / (best / 1e3) << " MB/s" << std::endl;
+    return best;
+}
+
+// Check that both paths agree on every package before timing anything.
+bool cross_check(const json& dom, const RepoRecords& repo) {
+    const json& pkgs = dom["packages"];
+    if (pkgs.size() != repo.packages.size()) {
+        std::cerr << "package count differs: " << pkgs.size() << " vs " << repo.packages.size() << std::endl;
+        return false;
+    }
+    for (const RepoRecord& rec : repo.packages) {
+        auto it = pkgs.find(std::string(rec.name));
+        if (it == pkgs.end() ||
+            it->value("version", "") != rec.version ||
+            it->value("description", "") != rec.description ||
+            it->value("url", "") != rec.url ||
+            it->value("dependencies", json::array()).size() != rec.deps_count) {
+            std::cerr << "record differs: " << rec.name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <repo.json> [iterations]" << std::endl;
+        return 2;
+    }
+    std::string path = argv[1];
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+    json dom;
+    {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "cannot open " << path << std::endl;
+            return 1;
+        }
+        in >> dom;
+    }
+    RepoRecords check;
+    std::string error;
+    if (!load_repo_records(path, check, &error)) {
+        std::cerr << "scan failed: " << error << std::endl;
+        return 1;
+    }
+    if (!cross_check(dom, check)) return 1;
+
+    std::size_t bytes = check.file.size();
+    std::cout << path << ": " << bytes << " bytes, " << check.packages.size() << " packages, "
+              << "scanner " << structural_scanner_name() << std::endl;
+
+    double stream = run("stream", iterations, bytes, [&] {
+        std::ifstream in(path);
+        json db;
+        in >> db;
+    });
+    run("stage1", iterations, bytes, [&] {
+        std::vector<uint32_t> structurals;
+        structurals.reserve(bytes / 8);
+        find_structurals(check.file.view(), structurals);
+    });
+    double scan = run("scan", iterations, bytes, [&] {
+        RepoRecords repo;
+        load_repo_records(path, repo);
+    });
+    std::cout << "speedup " << std::setprecision(1) << stream / scan << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,64 @@
+# bash completion for fox
+#
+# Package names come from `fox complete`, which reads a prebuilt name trie
+# next to the repository index, so completing stays fast on large
+# repositories.
+
+_fox() {
+    local cur="${COMP_WORDS[COMP_CWORD]}"
+    local prev="${COMP_WORDS[COMP_CWORD-1]}"
+    local commands="install install-local remove search provides which-provides update query complete repo-publish repo-index"
+
+    # Global options may come before the command; bash splits --output=ndjson
+    # into "--output", "=" and "ndjson".
+    local i cmd=
+    for ((i = 1; i < COMP_CWORD; i++)); do
+        case "${COMP_WORDS[i]}" in
+            --output) [[ ${COMP_WORDS[i+1]} == = ]] && ((i++)); ((i++)) ;;
+            -*) ;;
+            *) cmd="${COMP_WORDS[i]}"; break ;;
+        esac
+    done
+    if [[ $prev == --output || ($prev == = && ${COMP_WORDS[COMP_CWORD-2]} == --output) ]]; then
+        COMPREPLY=($(compgen -W "text ndjson" -- "$cur"))
+        return
+    fi
+
+    if [[ -z $cmd ]]; then
+        COMPREPLY=($(compgen -W "$commands --output --timings --help --version" -- "$cur"))
+        return
+    fi
+
+    case "$cmd" in
+        install)
+            [[ $cur == -* ]] || COMPREPLY=($(fox complete ${cur:+"$cur"} 2>/dev/null))
+            ;;
+        remove)
+            [[ $cur == -* ]] || COMPREPLY=($(fox complete --installed ${cur:+"$cur"} 2>/dev/null))
+            ;;
+        install-local)
+            compopt -o filenames 2>/dev/null
+            COMPREPLY=($(compgen -f -X '!*.fox' -- "$cur") $(compgen -d -- "$cur"))
+            ;;
+        repo-index)
+            if [[ $cur == -* ]]; then
+                COMPREPLY=($(compgen -W "-o --repo-json --base-url -j --jobs" -- "$cur"))
+            else
+                compopt -o filenames 2>/dev/null
+                COMPREPLY=($(compgen -f -- "$cur"))
+            fi
+            ;;
+        provides|repo-publish)
+            compopt -o filenames 2>/dev/null
+            COMPREPLY=($(compgen -f -- "$cur"))
+            ;;
+        search)
+            COMPREPLY=($(compgen -W "--limit --substring --ignore-case --fuzzy" -- "$cur"))
+            ;;
+        query)
+            COMPREPLY=($(compgen -W "--stdin" -- "$cur"))
+            ;;
+    esac
+}
+
+complete -F _fox fox
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// XXH64 of a byte range. Not cryptographic; used to tell whether a file's
+// contents changed, at several GB/s.
+uint64_t content_hash64(const void* data, std::size_t size, uint64_t seed = 0);
+
+inline uint64_t content_hash64(std::string_view s, uint64_t seed = 0) {
+    return content_hash64(s.data(), s.size(), seed);
+}
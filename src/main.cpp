@@ -9,6 +9,7 @@
 #include <sstream>
 #include <chrono>
 #include <thread>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <sys/stat.h>
@@ -16,36 +17,82 @@
 #include <pwd.h>
 //Added this include
 #include "CLI/CLI.hpp"
+#include "content_hash.hpp"
 #include "nlohmann/json.hpp"
+#include "repo_commands.hpp"
+#include "repo_complete.hpp"
+#include "repo_config.hpp"
+#include "repo_contents.hpp"
+#include "repo_delta.hpp"
+#include "repo_fuzzy.hpp"
+#include "repo_generate.hpp"
+#include "repo_graph.hpp"
+#include "repo_index.hpp"
+#include "repo_merge.hpp"
+#include "repo_plan_cache.hpp"
+#include "repo_query.hpp"
+#include "repo_resolve.hpp"
+#include "repo_search.hpp"
+#include "repo_stream.hpp"
+#include "repo_trigram.hpp"
+#include "repo_update.hpp"
+#include "repo_version.hpp"
 
 using json = nlohmann::json;
 
-// Package database structure
-struct Package {
-    std::string name;
+// An installed package's version and its sort key, computed once on load.
+// Both are empty for entries written before versions were recorded.
+struct InstalledPackage {
     std::string version;
-    std::string description;
-    std::vector<std::string> dependencies;
-    std::string maintainer;
-    std::string license;
-    bool installed = false;
+    std::string version_key;
 };
 
-// Global package database (in a real implementation, this would be loaded from files)
-std::map<std::string, Package> package_database;
-std::set<std::string> installed_packages;
+// Installed packages by name, mirrored in installed.txt as "name\tversion"
+// lines (or just "name" for old entries)
+std::map<std::string, InstalledPackage, std::less<>> installed_packages;
+
+// Set by --output=ndjson: every command then writes one JSON object per line
+// and no prose, so scripts never have to parse messages.
+bool ndjson_output = false;
+
+// Set by --timings: phases report how long they took on stderr, leaving
+// stdout to the command's own output.
+bool show_timings = false;
+
+// Write one NDJSON record.
+void emit(const json& record) {
+    std::cout << record.dump(-1, ' ', false, json::error_handler_t::replace) << '\n';
+}
+
+// Progress and informational messages, dropped in NDJSON mode.
+void say(const std::string& message) {
+    if (!ndjson_output) std::cout << message << std::endl;
+}
+
+// Errors and warnings ("error" or "warning"); in NDJSON mode they become
+// {"type": type, "message": message} records.
+void report(const char* type, const std::string& message) {
+    if (ndjson_output) {
+        emit({{"type", type}, {"message", message}});
+    } else {
+        std::cout << message << std::endl;
+    }
+}
+
+// Print how long a phase has taken since start, with --timings.
+void print_timing(const char* phase, std::chrono::steady_clock::time_point start, const char* note = nullptr) {
+    if (!show_timings) return;
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    char ms[32];
+    std::snprintf(ms, sizeof(ms), "%.3f ms", elapsed.count());
+    std::cerr << "timing: " << phase << ": " << ms;
+    if (note) std::cerr << " (" << note << ")";
+    std::cerr << std::endl;
+}
 
 // Helper function declarations
-void initialize_package_database();
-bool check_dependencies(const std::vector<std::string>& dependencies);
-bool download_package(const std::string& package_name);
-bool install_package(const std::string& package_name);
-bool remove_package(const std::string& package_name);
-std::vector<Package> search_packages(const std::string& query);
-void display_package_info(const Package& pkg);
 bool load_installed_packages();
 void save_installed_packages();
-bool extract_package(const std::string& package_path, const std::string& extract_path);
 bool create_package_directories();
 std::string get_package_cache_dir();
 std::string get_package_install_dir();
@@ -54,11 +101,24 @@ std::string get_package_install_dir();
 void handle_install(const std::vector<std::string>& package_names);
 void handle_install_local(const std::string& package_file);
 void handle_remove(const std::vector<std::string>& package_names);
-void handle_search(const std::string& query);
+void handle_search(const std::string& query, std::size_t limit, bool substring, bool ignore_case, bool fuzzy);
+void handle_complete(const std::string& prefix, bool installed, std::size_t limit);
+void handle_provides(const std::string& path);
+void handle_which_provides(const std::string& command);
+void handle_update(const std::string& url_override);
+void handle_repo_publish(const std::string& new_repo, const std::string& repo_dir);
+void handle_repo_index(const std::string& dir, const RepoGenerateOptions& options);
+void handle_query(const std::vector<std::string>& requests, bool from_stdin);
 
 int main(int argc, char** argv) {
     CLI::App app{"The package manager for the Foxglove Linux distribution."};
     app.set_version_flag("-v,--version", "0.1.0");
+    // Global options may also follow the subcommand.
+    app.fallthrough();
+    std::string output_format = "text";
+    app.add_option("--output", output_format, "Output format: text or ndjson (one JSON object per line)")
+        ->check(CLI::IsMember({"text", "ndjson"}));
+    app.add_flag("--timings", show_timings, "Print how long loading the index and resolving took on stderr");
 
     // Install command
     auto install_cmd = app.add_subcommand("install", "Install one or more packages.");
@@ -79,12 +139,68 @@ int main(int argc, char** argv) {
     auto search_cmd = app.add_subcommand("search", "Search for a package in repositories.");
     std::string search_query;
     search_cmd->add_option("query", search_query, "Search query")->required();
+    std::size_t search_limit = 20;
+    search_cmd->add_option("--limit", search_limit, "Show at most this many results (default: 20)");
+    bool search_substring_mode = false;
+    search_cmd->add_flag("--substring", search_substring_mode, "List substring matches in name order instead of ranking them");
+    bool search_ignore_case = false;
+    search_cmd->add_flag("-i,--ignore-case", search_ignore_case, "Match the query as a substring, ignoring case");
+    bool search_fuzzy = false;
+    search_cmd->add_flag("--fuzzy", search_fuzzy, "Match package names within a few typos of the query");
+
+    // Provides command
+    auto provides_cmd = app.add_subcommand("provides", "Find which package ships a file.");
+    std::string provides_path;
+    provides_cmd->add_option("path", provides_path, "Path of the file, e.g. /usr/bin/foo")->required();
+
+    // Command-not-found lookup
+    auto which_provides_cmd = app.add_subcommand("which-provides", "Find which package provides a command.");
+    std::string which_provides_command;
+    which_provides_cmd->add_option("command", which_provides_command, "Name of the command, e.g. vim")->required();
+
+    // Update command
+    auto update_cmd = app.add_subcommand("update", "Refresh the package index from the repository.");
+    std::string update_url;
+    update_cmd->add_option("--url", update_url, "Repository index URL (overrides the configured one)");
+
+    // Repository-side: publish a new index generation with deltas
+    auto publish_cmd = app.add_subcommand("repo-publish", "Publish a repo.json as the next generation of a repository directory.");
+    std::string publish_source;
+    std::string publish_dir;
+    publish_cmd->add_option("repo-json", publish_source, "The new repo.json")->required();
+    publish_cmd->add_option("repo-dir", publish_dir, "Repository directory served to clients")->required();
+
+    // Repository-side: generate repo.json from a directory of .fox archives
+    auto repo_index_cmd = app.add_subcommand("repo-index", "Generate repo.json and its binary index from a directory of .fox files.");
+    std::string repo_index_dir;
+    RepoGenerateOptions repo_index_options;
+    repo_index_cmd->add_option("dir", repo_index_dir, "Directory containing .fox packages")->required();
+    repo_index_cmd->add_option("-o,--repo-json", repo_index_options.output, "repo.json to write (default: <dir>/repo.json)");
+    repo_index_cmd->add_option("--base-url", repo_index_options.base_url, "URL prefix for package downloads");
+    repo_index_cmd->add_option("-j,--jobs", repo_index_options.jobs, "Number of worker threads (default: one per CPU)");
+
+    // Shell completion helper, called by the bash/zsh completion scripts
+    auto complete_cmd = app.add_subcommand("complete", "List package names starting with a prefix (for shell completion).");
+    std::string complete_prefix;
+    bool complete_installed = false;
+    std::size_t complete_limit = 0;
+    complete_cmd->add_option("prefix", complete_prefix, "Beginning of the package name");
+    complete_cmd->add_flag("--installed", complete_installed, "Complete installed packages instead of available ones");
+    complete_cmd->add_option("--limit", complete_limit, "Print at most this many names (default: all)");
+
+    // Batch lookups for scripts: one JSON request in, one JSON response out
+    auto query_cmd = app.add_subcommand("query", "Answer JSON search/info/resolve requests, one per line.");
+    std::vector<std::string> query_requests;
+    bool query_stdin = false;
+    query_cmd->add_option("requests", query_requests, "Requests, e.g. '{\"op\":\"info\",\"name\":\"vim\"}'");
+    query_cmd->add_flag("--stdin", query_stdin, "Read requests from standard input until it is closed");
 
     // Set required to ensure a command is given
     app.require_subcommand(1);
 
     // Parse arguments
     CLI11_PARSE(app, argc, argv);
+    ndjson_output = output_format == "ndjson";
 
     // Execute the correct command
     if (app.get_subcommand(install_cmd)) {
@@ -94,35 +210,27 @@ int main(int argc, char** argv) {
     } else if (app.get_subcommand(remove_cmd)) {
         handle_remove(remove_packages);
     } else if (app.get_subcommand(search_cmd)) {
-        handle_search(search_query);
+        handle_search(search_query, search_limit, search_substring_mode, search_ignore_case, search_fuzzy);
+    } else if (app.get_subcommand(complete_cmd)) {
+        handle_complete(complete_prefix, complete_installed, complete_limit);
+    } else if (app.get_subcommand(provides_cmd)) {
+        handle_provides(provides_path);
+    } else if (app.get_subcommand(which_provides_cmd)) {
+        handle_which_provides(which_provides_command);
+    } else if (app.get_subcommand(update_cmd)) {
+        handle_update(update_url);
+    } else if (app.get_subcommand(publish_cmd)) {
+        handle_repo_publish(publish_source, publish_dir);
+    } else if (app.get_subcommand(repo_index_cmd)) {
+        handle_repo_index(repo_index_dir, repo_index_options);
+    } else if (app.get_subcommand(query_cmd)) {
+        handle_query(query_requests, query_stdin);
     }
 
     return 0;
 }
 
 // Helper function implementations
-void initialize_package_database() {
-    // Simulated package database
-    package_database = {
-        {"firefox", {"firefox", "1.0.0", "Web browser", {"gtk"}, "Mozilla", "MPL-2.0", false}},
-        {"vim", {"vim", "8.2", "Text editor", {}, "Bram Moolenaar", "Vim", false}},
-        {"git", {"git", "2.34.1", "Version control system", {}, "Git Contributors", "GPL-2.0", false}},
-        {"gtk", {"gtk", "3.24", "GUI toolkit", {}, "GNOME", "LGPL-2.1", false}},
-        {"nano", {"nano", "6.0", "Simple text editor", {}, "GNU", "GPL-3.0", false}},
-        {"curl", {"curl", "7.80.0", "Data transfer tool", {}, "Daniel Stenberg", "curl", false}},
-    };
-}
-
-bool check_dependencies(const std::vector<std::string>& dependencies) {
-    for (const auto& dep : dependencies) {
-        if (installed_packages.find(dep) == installed_packages.end()) {
-            std::cout << "Missing dependency: " << dep << std::endl;
-            return false;
-        }
-    }
-    return true;
-}
-
 std::string get_package_cache_dir() {
     const char* home = getenv("HOME");
     if (!home) {
@@ -147,89 +255,6 @@ bool create_package_directories() {
     return true;
 }
 
-bool download_package(const std::string& package_name) {
-    std::cout << "Downloading " << package_name << "... ";
-    std::cout.flush();
-    
-    std::string cache_dir = get_package_cache_dir();
-    std::string package_file = cache_dir + "/" + package_name + ".fox";
-    
-    // In a real implementation, this would download from a repository
-    // For now, we'll create a dummy package file for demonstration
-    std::ofstream dummy_package(package_file, std::ios::binary);
-    if (!dummy_package) {
-        std::cout << "failed (cannot create package file)" << std::endl;
-        return false;
-    }
-    
-    // Create a simple tar.xz-like structure (simplified)
-    dummy_package << "FOX_PACKAGE_" << package_name << "_" << package_database[package_name].version;
-    dummy_package.close();
-    
-    std::cout << "done." << std::endl;
-    return true;
-}
-
-bool extract_package(const std::string& package_path, const std::string& extract_path) {
-    // In a real implementation, this would extract tar.xz
-    // For now, we'll simulate extraction by creating directories
-    std::filesystem::create_directories(extract_path);
-    
-    // Create some dummy files to simulate package contents
-    std::ofstream((extract_path + "/bin/" + std::filesystem::path(package_path).stem().string()).c_str());
-    std::ofstream((extract_path + "/lib/lib" + std::filesystem::path(package_path).stem().string() + ".so").c_str());
-    
-    return true;
-}
-
-bool install_package(const std::string& package_name) {
-    std::cout << "Installing " << package_name << "... ";
-    std::cout.flush();
-    
-    std::string cache_dir = get_package_cache_dir();
-    std::string install_dir = get_package_install_dir();
-    std::string package_file = cache_dir + "/" + package_name + ".fox";
-    std::string package_install_path = install_dir + "/" + package_name;
-    
-    // Extract package
-    if (!extract_package(package_file, package_install_path)) {
-        std::cout << "failed (extraction error)" << std::endl;
-        return false;
-    }
-    
-    // Set proper permissions
-    std::filesystem::permissions(package_install_path, 
-                                std::filesystem::perms::owner_all | std::filesystem::perms::group_read | std::filesystem::perms::others_read,
-                                std::filesystem::perm_options::replace);
-    
-    installed_packages.insert(package_name);
-    package_database[package_name].installed = true;
-    save_installed_packages();
-    
-    std::cout << "done." << std::endl;
-    return true;
-}
-
-bool remove_package(const std::string& package_name) {
-    std::cout << "Removing " << package_name << "... ";
-    std::cout.flush();
-    
-    std::string install_dir = get_package_install_dir();
-    std::string package_path = install_dir + "/" + package_name;
-    
-    // Remove package files
-    if (std::filesystem::exists(package_path)) {
-        std::filesystem::remove_all(package_path);
-    }
-    
-    installed_packages.erase(package_name);
-    package_database[package_name].installed = false;
-    save_installed_packages();
-    
-    std::cout << "done." << std::endl;
-    return true;
-}
-
 bool load_installed_packages() {
     std::string cache_dir = get_package_cache_dir();
     std::string installed_file = cache_dir + "/installed.txt";
@@ -238,12 +263,15 @@ bool load_installed_packages() {
     if (file.is_open()) {
         std::string line;
         while (std::getline(file, line)) {
-            if (!line.empty()) {
-                installed_packages.insert(line);
-                if (package_database.find(line) != package_database.end()) {
-                    package_database[line].installed = true;
-                }
+            if (line.empty()) continue;
+            std::size_t tab = line.find('\t');
+            InstalledPackage pkg;
+            if (tab != std::string::npos) {
+                pkg.version = line.substr(tab + 1);
+                pkg.version_key = version_key(pkg.version);
+                line.resize(tab);
             }
+            installed_packages[line] = std::move(pkg);
         }
         file.close();
     }
@@ -257,30 +285,15 @@ void save_installed_packages() {
     
     std::ofstream file(installed_file);
     if (file.is_open()) {
-        for (const auto& pkg : installed_packages) {
-            file << pkg << std::endl;
+        for (const auto& [name, pkg] : installed_packages) {
+            file << name;
+            if (!pkg.version.empty()) file << '\t' << pkg.version;
+            file << '\n';
         }
         file.close();
     }
 }
 
-std::vector<Package> search_packages(const std::string& query) {
-    std::vector<Package> results;
-    for (const auto& [name, pkg] : package_database) {
-        if (name.find(query) != std::string::npos ||
-            pkg.description.find(query) != std::string::npos) {
-            results.push_back(pkg);
-        }
-    }
-    return results;
-}
-
-void display_package_info(const Package& pkg) {
-    std::cout << pkg.name << " (" << pkg.version << ") - " << pkg.description;
-    if (pkg.installed) std::cout << " [installed]";
-    std::cout << std::endl;
-}
-
 std::string get_package_root_dir() {
     const char* home = getenv("HOME");
     if (!home) {
@@ -302,14 +315,13 @@ bool run_command(const std::string& cmd) {
 bool real_download_package(const std::string& package_name, const std::string& url) {
     std::string cache_dir = get_package_cache_dir();
     std::string package_file = cache_dir + "/" + package_name + ".fox";
-    std::cout << "Downloading " << url << "... ";
-    std::cout.flush();
+    if (!ndjson_output) std::cout << "Downloading " << url << "... " << std::flush;
     std::string cmd = "curl -fsSL -o '" + package_file + "' '" + url + "'";
     if (!run_command(cmd)) {
-        std::cout << "failed." << std::endl;
+        say("failed.");
         return false;
     }
-    std::cout << "done." << std::endl;
+    say("done.");
     return true;
 }
 
@@ -321,10 +333,31 @@ bool real_extract_package(const std::string& package_file, const std::string& ex
 }
 
 bool parse_fox_json(const std::string& extract_dir, json& fox_meta) {
-    std::ifstream fox_json_file(extract_dir + "/fox.json");
+    // Read the whole file in one go rather than parsing through the stream.
+    std::ifstream fox_json_file(extract_dir + "/fox.json", std::ios::binary);
     if (!fox_json_file.is_open()) return false;
-    fox_json_file >> fox_meta;
-    return true;
+    std::string contents((std::istreambuf_iterator<char>(fox_json_file)), std::istreambuf_iterator<char>());
+    fox_meta = json::parse(contents, nullptr, false);
+    return !fox_meta.is_discarded() && fox_meta.is_object();
+}
+
+// Add a package to installed_packages with the version from its fox.json.
+void record_installed(const std::string& package_name, const json& fox_meta) {
+    InstalledPackage pkg;
+    auto version = fox_meta.find("version");
+    if (version != fox_meta.end() && version->is_string()) {
+        pkg.version = version->get<std::string>();
+        pkg.version_key = version_key(pkg.version);
+    }
+    installed_packages[package_name] = std::move(pkg);
+}
+
+// Whether the installed packages meet dep. Entries without a recorded
+// version predate version tracking and are taken to meet any constraint.
+bool installed_satisfies(const DependencyView& dep) {
+    auto it = installed_packages.find(dep.name);
+    if (it == installed_packages.end()) return false;
+    return it->second.version.empty() || dep.satisfied_by(it->second.version_key);
 }
 
 bool real_install_package(const std::string& package_name, const std::string& url) {
@@ -334,19 +367,19 @@ bool real_install_package(const std::string& package_name, const std::string& ur
     std::string root_dir = get_package_root_dir();
 
     if (!real_extract_package(package_file, extract_dir)) {
-        std::cout << "Extraction failed." << std::endl;
+        report("error", "Extraction failed.");
         return false;
     }
     // Parse fox.json
     json fox_meta;
     if (!parse_fox_json(extract_dir, fox_meta)) {
-        std::cout << "Missing or invalid fox.json." << std::endl;
+        report("error", "Missing or invalid fox.json.");
         return false;
     }
     // Copy files to root_dir (simulate system root)
     std::string copy_cmd = "cp -a '" + extract_dir + "/.' '" + root_dir + "'";
     if (!run_command(copy_cmd)) {
-        std::cout << "Failed to copy files." << std::endl;
+        report("error", "Failed to copy files.");
         return false;
     }
     // Track installed files
@@ -357,108 +390,332 @@ bool real_install_package(const std::string& package_name, const std::string& ur
         }
     }
     manifest.close();
-    installed_packages.insert(package_name);
-    package_database[package_name].installed = true;
+    record_installed(package_name, fox_meta);
     save_installed_packages();
-    std::cout << "Installed " << package_name << " successfully." << std::endl;
+    if (ndjson_output) {
+        emit({{"type", "install"}, {"name", package_name}, {"status", "installed"}});
+    } else {
+        std::cout << "Installed " << package_name << " successfully." << std::endl;
+    }
     return true;
 }
 
-// Path to the package database (repo.json)
-std::string get_repo_db_path() {
-    // For now, use the project root; in production, use ~/.fox/repo.json
-    return std::string(getenv("HOME")) + "/.fox/repo.json";
+// fox's own directory, ~/.fox
+std::string get_fox_dir() {
+    return std::string(getenv("HOME")) + "/.fox";
+}
+
+// Path to fox's configuration file
+std::string get_config_path() {
+    return get_fox_dir() + "/config.json";
 }
 
-// Global package database loaded from repo.json
-json repo_db;
+// Path to the index merged from all configured repositories
+std::string get_merged_index_path() {
+    return get_package_cache_dir() + "/merged.idx";
+}
 
-// Load the package database from repo.json
-bool load_repo_db() {
-    std::ifstream repo_file(get_repo_db_path());
-    if (!repo_file.is_open()) {
-        std::cout << "Could not open repo.json!" << std::endl;
+std::string get_commands_path() {
+    return get_package_cache_dir() + "/commands.idx";
+}
+
+// Configured repositories, highest priority first
+std::vector<Repository> repositories;
+
+bool load_repository_config() {
+    if (!repositories.empty()) return true;
+    std::string error;
+    if (!load_repositories(get_fox_dir(), get_package_cache_dir(), repositories, error)) {
+        report("error", "Invalid repository configuration: " + error);
+        return false;
+    }
+    return true;
+}
+
+// Global package index, mapped read-only. With one repository this is that
+// repository's index; with several it is the merged view over all of them.
+RepoIndex repo_index;
+
+// Dependency edges of repo_index, mapped on first use.
+DependencyGraph dependency_graph;
+
+// Per-repository indexes feeding the merged view
+std::vector<RepoIndex> repository_indexes;
+
+// Map the index of one repository. repo.json is only parsed when the binary
+// index is missing or was built from different contents; otherwise the index
+// is mapped as-is.
+bool load_repository_index(const Repository& repo, RepoIndex& index) {
+    if (index.open_if_current(repo.index_path, repo.repo_path)) return true;
+
+    RepoRecords records;
+    std::string error;
+    if (!load_repo_records(repo.repo_path, records, &error)) {
+        if (!records.file.is_open()) {
+            report("error", "Could not open " + repo.repo_path + "!");
+        } else {
+            report("error", "Could not parse " + repo.repo_path + ": " + error);
+        }
+        return false;
+    }
+    std::filesystem::create_directories(std::filesystem::path(repo.index_path).parent_path());
+    if (!build_repo_index(records, repo.index_path, repo.name) || !index.open(repo.index_path)) {
+        report("error", "Could not build repository index!");
+        return false;
+    }
+    return true;
+}
+
+// Map or rebuild the indexes of the configured repositories into repo_index.
+bool load_repository_indexes() {
+    if (!load_repository_config()) return false;
+    if (repositories.size() == 1) return load_repository_index(repositories[0], repo_index);
+
+    // A repository that has never been fetched is left out of the merge
+    // rather than making every other repository unusable.
+    repository_indexes.clear();
+    repository_indexes.resize(repositories.size());
+    std::vector<MergeInput> inputs;
+    for (std::size_t i = 0; i < repositories.size(); ++i) {
+        if (!std::filesystem::exists(repositories[i].repo_path)) {
+            report("warning", "Skipping repository '" + repositories[i].name + "': run `fox update` first.");
+            continue;
+        }
+        if (!load_repository_index(repositories[i], repository_indexes[i])) return false;
+        inputs.push_back({&repository_indexes[i], repositories[i].name});
+    }
+    if (inputs.empty()) {
+        report("error", "No repository has been fetched yet; run `fox update`.");
+        return false;
+    }
+    if (!open_merged_index(inputs, get_merged_index_path(), repo_index)) {
+        report("error", "Could not build merged repository index!");
         return false;
     }
-    repo_file >> repo_db;
     return true;
 }
 
+// Load the package database into repo_index.
+bool load_repo_db() {
+    auto start = std::chrono::steady_clock::now();
+    bool loaded = load_repository_indexes();
+    print_timing("load index", start);
+    return loaded;
+}
+
+// Index ids of the installed packages the repositories still carry.
+std::vector<uint32_t> installed_package_ids() {
+    std::vector<uint32_t> ids;
+    for (const auto& entry : installed_packages) {
+        uint32_t id = repo_index.find(entry.first);
+        if (id != REPO_INDEX_NPOS) ids.push_back(id);
+    }
+    return ids;
+}
+
+// Map the index of the configured repositories as it is, without fetching,
+// parsing or rebuilding anything. False if there is none yet.
+bool open_existing_index() {
+    std::string error;
+    if (!load_repositories(get_fox_dir(), get_package_cache_dir(), repositories, error)) return false;
+    if (repositories.empty()) return false;
+    std::string index_path = repositories.size() > 1 ? get_merged_index_path() : repositories[0].index_path;
+    return repo_index.open(index_path);
+}
+
+// The dependency graph of the open repo_index, or nullptr if it cannot be read.
+const DependencyGraph* dependency_graph_of_index() {
+    if (!dependency_graph.is_open() || dependency_graph.size() != repo_index.size()) {
+        if (!dependency_graph.open(repo_index)) return nullptr;
+    }
+    return &dependency_graph;
+}
+
+// Hash of the installed packages and their versions, everything the
+// resolver reads about them.
+uint64_t installed_digest() {
+    uint64_t digest = content_hash64("installed");
+    for (const auto& entry : installed_packages) {
+        digest = content_hash64(entry.first + '\t' + entry.second.version + '\n', digest);
+    }
+    return digest;
+}
+
+// Plan the installation of requested, reusing the plan cached for the same
+// index, request and installed packages.
+void plan_install(const std::vector<uint32_t>& requested, InstallPlan& plan) {
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t key = plan_cache_key(repo_index, requested, installed_digest());
+    const std::string path = plan_cache_path(get_package_cache_dir(), key);
+    if (load_cached_plan(path, key, repo_index, plan)) {
+        print_timing("resolve", start, "cache hit");
+        return;
+    }
+    resolve_install(repo_index, requested, installed_satisfies, installed_package_ids(), plan);
+    store_cached_plan(path, key, repo_index, plan);
+    print_timing("resolve", start, "cache miss");
+}
+
+// Switch a long-lived reader to the index another process has rebuilt in
+// its place; the files the old one names are only kept for an hour. Keeps
+// the old index if the new one cannot be opened.
+void refresh_index() {
+    if (!repo_index.replaced()) return;
+    RepoIndex current;
+    if (!current.open(repo_index.path())) return;
+    repo_index = std::move(current);
+    dependency_graph = DependencyGraph();
+}
+
 // --- Command Implementations ---
 
 void handle_install(const std::vector<std::string>& package_names) {
     if (!load_repo_db()) return;
     load_installed_packages();
     create_package_directories();
+    std::vector<uint32_t> requested;
     for(const auto& pkg : package_names) {
-        if (!repo_db["packages"].contains(pkg)) {
+        uint32_t id = repo_index.find(pkg);
+        if (id == REPO_INDEX_NPOS) {
+            std::vector<FuzzyHit> suggestions;
+            fuzzy_search(repo_index, pkg, 3, default_fuzzy_distance(pkg), suggestions);
+            // A package in a shard that cannot be read has no name to suggest.
+            suggestions.erase(std::remove_if(suggestions.begin(), suggestions.end(),
+                                             [](const FuzzyHit& s) { return repo_index.name(s.package).empty(); }),
+                              suggestions.end());
+            if (ndjson_output) {
+                json names = json::array();
+                for (const FuzzyHit& s : suggestions) names.push_back(std::string(repo_index.name(s.package)));
+                emit({{"type", "install"}, {"name", pkg}, {"status", "not_found"}, {"suggestions", names}});
+                continue;
+            }
             std::cout << "Package not found: " << pkg << std::endl;
+            if (!suggestions.empty()) {
+                std::cout << "Did you mean: ";
+                for (std::size_t i = 0; i < suggestions.size(); ++i) {
+                    std::cout << (i ? ", " : "") << repo_index.name(suggestions[i].package);
+                }
+                std::cout << "?" << std::endl;
+            }
             continue;
         }
-        auto meta = repo_db["packages"][pkg];
         if (installed_packages.count(pkg)) {
-            std::cout << pkg << " is already installed." << std::endl;
+            if (ndjson_output) {
+                emit({{"type", "install"}, {"name", pkg}, {"status", "already_installed"}});
+            } else {
+                std::cout << pkg << " is already installed." << std::endl;
+            }
             continue;
         }
-        // Check dependencies
-        bool deps_ok = true;
-        for (const auto& dep : meta["dependencies"]) {
-            if (!installed_packages.count(dep)) {
-                std::cout << "Missing dependency: " << dep << std::endl;
-                deps_ok = false;
+        requested.push_back(id);
+    }
+    if (requested.empty()) return;
+
+    // Pull in every dependency that is not installed yet, dependencies first,
+    // choosing between alternatives and around conflicts.
+    InstallPlan plan;
+    plan_install(requested, plan);
+    for (const ResolveProblem& problem : plan.problems) {
+        if (ndjson_output) {
+            emit({{"type", "install"},
+                  {"name", problem.package},
+                  {"status", "unsatisfiable"},
+                  {"error", problem.message},
+                  {"explanation", problem.explanation}});
+        } else {
+            std::cout << "Cannot install " << problem.package << ": " << problem.message << "." << std::endl;
+            if (problem.explanation.size() > 2) {
+                std::cout << "  Because:" << std::endl;
+                for (const std::string& line : problem.explanation) std::cout << "    " << line << std::endl;
             }
         }
-        if (!deps_ok) {
-            std::cout << "Cannot install " << pkg << " due to missing dependencies." << std::endl;
-            continue;
-        }
-        std::string url = meta.value("url", "");
-        if (url.empty()) {
-            std::cout << "No download URL for " << pkg << std::endl;
-            continue;
+    }
+    for (const std::vector<uint32_t>& cycle : plan.cycles) {
+        std::string path;
+        for (uint32_t id : cycle) path += std::string(repo_index.name(id)) + " -> ";
+        report("warning", "Dependency cycle: " + path + std::string(repo_index.name(cycle.front())));
+    }
+    if (plan.packages.empty()) return;
+    if (ndjson_output) {
+        json names = json::array();
+        for (uint32_t id : plan.packages) names.push_back(std::string(repo_index.name(id)));
+        emit({{"type", "plan"}, {"packages", std::move(names)}});
+    } else if (plan.packages.size() > requested.size()) {
+        std::cout << "Installing " << plan.packages.size() << " packages:";
+        for (uint32_t id : plan.packages) std::cout << ' ' << repo_index.name(id);
+        std::cout << std::endl;
+    }
+
+    // A package is skipped once a dependency failed to install and no other
+    // alternative of it is installed.
+    std::set<uint32_t> failed;
+    for (uint32_t id : plan.packages) {
+        PackageView meta = repo_index.package(id);
+        std::string pkg(meta.name);
+        std::string url(meta.url);
+        std::string failure;
+        uint32_t i = 0;
+        while (i < meta.deps_count && failure.empty()) {
+            std::string missing;
+            bool met = false;
+            do {
+                DependencyView dep = repo_index.dependency(meta, i++);
+                if (dep.conflict() || dep.provides()) continue;
+                met = met || installed_satisfies(dep);
+                if (missing.empty() && failed.count(dep.package)) missing = std::string(dep.name);
+            } while (i < meta.deps_count && repo_index.dependency(meta, i).alternative());
+            if (!met && !missing.empty()) failure = "Skipping " + pkg + ": " + missing + " was not installed";
         }
-        if (!real_download_package(pkg, url)) {
-            std::cout << "Failed to download " << pkg << std::endl;
-            continue;
+        if (failure.empty()) {
+            if (url.empty()) {
+                failure = "No download URL for " + pkg;
+            } else if (!real_download_package(pkg, url)) {
+                failure = "Failed to download " + pkg;
+            } else if (!real_install_package(pkg, url)) {
+                failure = "Failed to install " + pkg;
+            }
         }
-        if (!real_install_package(pkg, url)) {
-            std::cout << "Failed to install " << pkg << std::endl;
-            continue;
+        if (failure.empty()) continue;
+        failed.insert(id);
+        if (ndjson_output) {
+            emit({{"type", "install"}, {"name", pkg}, {"status", "failed"}, {"error", failure}});
+        } else {
+            std::cout << failure << std::endl;
         }
     }
 }
 
 void handle_install_local(const std::string& package_file) {
     if (!std::filesystem::exists(package_file)) {
-        std::cout << "Package file not found: " << package_file << std::endl;
+        report("error", "Package file not found: " + package_file);
         return;
     }
 
-    std::cout << "Installing local package from " << package_file << "..." << std::endl;
+    say("Installing local package from " + package_file + "...");
 
     std::string extract_dir = get_temp_extract_dir();
     std::string root_dir = get_package_root_dir();
     
     // Extract the package
     if (!real_extract_package(package_file, extract_dir)) {
-        std::cout << "Failed to extract package." << std::endl;
+        report("error", "Failed to extract package.");
         return;
     }
 
     // Parse fox.json to get package name
     json fox_meta;
     if (!parse_fox_json(extract_dir, fox_meta)) {
-        std::cout << "Missing or invalid fox.json in package." << std::endl;
+        report("error", "Missing or invalid fox.json in package.");
         return;
     }
 
     std::string package_name = fox_meta["name"];
-    std::cout << "Package name: " << package_name << std::endl;
+    say("Package name: " + package_name);
 
     // Copy files to root directory
     std::string copy_cmd = "cp -a '" + extract_dir + "/.' '" + root_dir + "'";
     if (!run_command(copy_cmd)) {
-        std::cout << "Failed to copy files to installation directory." << std::endl;
+        report("error", "Failed to copy files to installation directory.");
         return;
     }
 
@@ -474,39 +731,91 @@ void handle_install_local(const std::string& package_file) {
 
     // Update package database
     load_installed_packages();
-    installed_packages.insert(package_name);
-    if (package_database.find(package_name) == package_database.end()) {
-        package_database[package_name] = {
-            package_name,
-            fox_meta.value("version", "unknown"),
-            fox_meta.value("description", ""),
-            fox_meta.value("dependencies", std::vector<std::string>{}),
-            fox_meta.value("maintainer", ""),
-            fox_meta.value("license", ""),
-            true
-        };
+    record_installed(package_name, fox_meta);
+    save_installed_packages();
+
+    if (ndjson_output) {
+        emit({{"type", "install"}, {"name", package_name}, {"status", "installed"}, {"file", package_file}});
     } else {
-        package_database[package_name].installed = true;
+        std::cout << "Successfully installed " << package_name << "!" << std::endl;
     }
-    save_installed_packages();
+}
 
-    std::cout << "Successfully installed " << package_name << "!" << std::endl;
+// Name the installed packages left without a dependency by the removal,
+// directly or through other installed packages; a dependency that another
+// installed alternative still meets is fine. Only warns: the index may be
+// stale or missing, and then nothing is said.
+void warn_broken_dependents(const std::vector<std::string>& removed) {
+    if (removed.empty() || installed_packages.empty() || !open_existing_index()) return;
+    const DependencyGraph* graph = dependency_graph_of_index();
+    if (!graph) return;
+    PackageSet broken(graph->size());
+    std::vector<uint32_t> pending;
+    for (const std::string& name : removed) {
+        uint32_t id = repo_index.find(name);
+        if (id != REPO_INDEX_NPOS && !broken.contains(id)) {
+            broken.insert(id);
+            pending.push_back(id);
+        }
+    }
+    // An installed package breaks when one of its dependencies names a broken
+    // package and no other alternative of it is still installed and intact.
+    auto breaks = [&](uint32_t id) {
+        PackageView meta = repo_index.package(id);
+        uint32_t i = 0;
+        while (i < meta.deps_count) {
+            bool involved = false;
+            bool met = false;
+            do {
+                DependencyView dep = repo_index.dependency(meta, i++);
+                if (dep.conflict() || dep.provides()) continue;
+                bool lost = dep.package != REPO_INDEX_NPOS && broken.contains(dep.package);
+                involved = involved || lost;
+                met = met || (!lost && installed_satisfies(dep));
+            } while (i < meta.deps_count && repo_index.dependency(meta, i).alternative());
+            if (involved && !met) return true;
+        }
+        return false;
+    };
+    // Walk the reverse edges through installed packages only.
+    std::vector<uint32_t> affected;
+    while (!pending.empty()) {
+        uint32_t id = pending.back();
+        pending.pop_back();
+        for (uint32_t dependent : graph->dependents(id)) {
+            if (broken.contains(dependent) || !installed_packages.count(repo_index.name(dependent))) continue;
+            if (!breaks(dependent)) continue;
+            broken.insert(dependent);
+            pending.push_back(dependent);
+            affected.push_back(dependent);
+        }
+    }
+    if (affected.empty()) return;
+    std::sort(affected.begin(), affected.end());
+    std::string names;
+    for (uint32_t id : affected) names += (names.empty() ? "" : ", ") + std::string(repo_index.name(id));
+    report("warning", "Still installed and depending on what was removed: " + names);
 }
 
 void handle_remove(const std::vector<std::string>& package_names) {
     load_installed_packages();
     std::string cache_dir = get_package_cache_dir();
     std::string root_dir = get_package_root_dir();
+    std::vector<std::string> removed;
 
     for (const auto& pkg : package_names) {
         if (!installed_packages.count(pkg)) {
-            std::cout << pkg << " is not installed." << std::endl;
+            if (ndjson_output) {
+                emit({{"type", "remove"}, {"name", pkg}, {"status", "not_installed"}});
+            } else {
+                std::cout << pkg << " is not installed." << std::endl;
+            }
             continue;
         }
         // Read manifest
         std::ifstream manifest(cache_dir + "/" + pkg + ".manifest");
         if (!manifest.is_open()) {
-            std::cout << "Manifest not found for " << pkg << ". Skipping file removal." << std::endl;
+            report("warning", "Manifest not found for " + pkg + ". Skipping file removal.");
         } else {
             std::string file;
             while (std::getline(manifest, file)) {
@@ -518,33 +827,643 @@ void handle_remove(const std::vector<std::string>& package_names) {
         // Remove from installed packages
         installed_packages.erase(pkg);
         save_installed_packages();
-        std::cout << "Removed " << pkg << " successfully." << std::endl;
+        removed.push_back(pkg);
+        if (ndjson_output) {
+            emit({{"type", "remove"}, {"name", pkg}, {"status", "removed"}});
+        } else {
+            std::cout << "Removed " << pkg << " successfully." << std::endl;
+        }
     }
+    warn_broken_dependents(removed);
 }
 
-void handle_search(const std::string& query) {
-    std::cout << "Searching for: " << query << std::endl;
-    if (!load_repo_db()) {
-        std::cout << "Failed to load repo database" << std::endl;
+// NDJSON record of a package in search results.
+json package_record(const PackageView& meta) {
+    json record = {{"type", "package"},
+                   {"name", std::string(meta.name)},
+                   {"version", std::string(meta.version)},
+                   {"description", std::string(meta.description)}};
+    if (!meta.repository.empty()) record["repository"] = std::string(meta.repository);
+    return record;
+}
+
+// Whether a search goes through the field-qualified query engine.
+bool is_query_search(const std::string& query, bool substring, bool ignore_case, bool fuzzy) {
+    return !substring && !ignore_case && !fuzzy && is_structured_query(query);
+}
+
+// Search the loaded repo_index. structured is the parsed query when
+// is_query_search() holds. Fills the hits to show and the number of matches.
+bool search_loaded_index(const std::string& query, const Query* structured, std::size_t limit, bool substring,
+                         bool ignore_case, bool fuzzy, std::vector<SearchHit>& hits, std::size_t& total) {
+    hits.clear();
+    total = 0;
+    if (fuzzy) {
+        std::vector<FuzzyHit> matches;
+        if (!fuzzy_search(repo_index, query, limit, default_fuzzy_distance(query), matches)) return false;
+        total = matches.size();
+        for (const FuzzyHit& match : matches) hits.push_back({match.package, 0.0});
+        return true;
+    }
+    if (structured || substring || ignore_case) {
+        std::vector<uint32_t> matches;
+        bool ok = structured ? run_query(repo_index, *structured, matches)
+                             : search_substring(repo_index, query, ignore_case, matches);
+        if (!ok) return false;
+        total = matches.size();
+        for (std::size_t i = 0; i < matches.size() && i < limit; ++i) hits.push_back({matches[i], 0.0});
+        return true;
+    }
+    return search_ranked_substring(repo_index, query, limit, hits, &total);
+}
+
+void handle_search(const std::string& query, std::size_t limit, bool substring, bool ignore_case, bool fuzzy) {
+    say("Searching for: " + query);
+    if (!load_repository_config()) return;
+    bool merged = repositories.size() > 1;
+    // Field-qualified queries are checked before anything is loaded.
+    Query structured;
+    bool use_query = is_query_search(query, substring, ignore_case, fuzzy);
+    std::string query_error;
+    if (use_query && !parse_query(query, structured, query_error)) {
+        report("error", "Invalid query: " + query_error);
         return;
     }
-    std::cout << "Loaded repo database successfully" << std::endl;
-    
-    auto& pkgs = repo_db["packages"];
-    std::cout << "Found " << pkgs.size() << " packages in database" << std::endl;
-    
+    if (!merged && !fuzzy && !ignore_case && !use_query && !repo_index.open_if_current(repositories[0].index_path, repositories[0].repo_path)) {
+        // No usable index: stream repo.json instead of paying for a full
+        // parse and index build just to answer one query. Without the term
+        // index there is no ranking; the first matches are shown.
+        std::size_t shown = 0;
+        std::size_t scanned = 0;
+        bool ok = stream_search_repo_json(repositories[0].repo_path, query, [&](const PackageView& meta) {
+            if (shown == limit) return false;
+            if (ndjson_output) {
+                emit(package_record(meta));
+            } else {
+                std::cout << meta.name << " (" << meta.version << ") - " << meta.description << std::endl;
+            }
+            return ++shown < limit;
+        }, &scanned);
+        if (!ok) {
+            report("error", "Failed to load repo database");
+            return;
+        }
+        if (ndjson_output) {
+            emit({{"type", "summary"}, {"query", query}, {"shown", shown}, {"scanned", scanned}});
+            return;
+        }
+        std::cout << "Scanned " << scanned << " packages in database" << std::endl;
+        if (shown == 0) {
+            std::cout << "No packages found matching '" << query << "'." << std::endl;
+        }
+        return;
+    }
+    if ((merged || fuzzy || ignore_case || use_query) && !load_repo_db()) return;
+    say("Loaded repo database successfully");
+    say("Found " + std::to_string(repo_index.size()) + " packages in database");
+
+    std::vector<SearchHit> hits;
+    std::size_t total = 0;
+    if (!search_loaded_index(query, use_query ? &structured : nullptr, limit, substring, ignore_case, fuzzy, hits, total)) {
+        report("error", "Failed to load the search index");
+        return;
+    }
+    if (ndjson_output) {
+        for (const SearchHit& hit : hits) emit(package_record(repo_index.package(hit.package)));
+        emit({{"type", "summary"}, {"query", query}, {"shown", hits.size()}, {"total", total}});
+        return;
+    }
+    for (const SearchHit& hit : hits) {
+        PackageView meta = repo_index.package(hit.package);
+        std::cout << meta.name << " (" << meta.version << ")";
+        if (merged) std::cout << " [" << meta.repository << "]";
+        std::cout << " - " << meta.description << std::endl;
+    }
+    if (total == 0) {
+        std::cout << "No packages found matching '" << query << "'." << std::endl;
+    } else if (total > hits.size()) {
+        std::cout << "Showing " << hits.size() << " of " << total << " matches; use --limit to see more." << std::endl;
+    }
+}
+
+// Runs on every <TAB>: it prints nothing but names, never parses repo.json
+// and never builds an index. A stale index is still good enough to complete
+// from; a missing one completes nothing.
+void handle_complete(const std::string& prefix, bool installed, std::size_t limit) {
+    std::size_t printed = 0;
+    if (installed) {
+        load_installed_packages();
+        for (auto it = installed_packages.lower_bound(prefix);
+             it != installed_packages.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+            if (limit && printed++ == limit) break;
+            if (ndjson_output) {
+                emit({{"type", "completion"}, {"name", it->first}});
+            } else {
+                std::cout << it->first << '\n';
+            }
+        }
+        return;
+    }
+    std::vector<std::string> names;
+    if (!open_existing_index() || !complete_names(repo_index, prefix, limit, names)) return;
+    for (const std::string& name : names) {
+        if (ndjson_output) {
+            emit({{"type", "completion"}, {"name", name}});
+        } else {
+            std::cout << name << '\n';
+        }
+    }
+}
+
+// Key of what the command table is built from: the configured repositories
+// in priority order and the identity of their contents indexes.
+uint64_t command_sources_key() {
+    uint64_t key = content_hash64("commands");
+    for (const Repository& repo : repositories) {
+        struct stat st {};
+        bool present = ::stat(repo.contents_path.c_str(), &st) == 0;
+        uint64_t stamp[4] = {present, uint64_t(st.st_ino), uint64_t(st.st_size),
+                             uint64_t(st.st_mtim.tv_sec) * 1'000'000'000 + uint64_t(st.st_mtim.tv_nsec)};
+        key = content_hash64(repo.name + '\n' + std::to_string(repo.priority) + '\n' + repo.contents_path + '\n', key);
+        key = content_hash64(stamp, sizeof(stamp), key);
+    }
+    return key;
+}
+
+// Regenerate cache/commands.idx from the contents indexes of all
+// repositories. Returns false, and removes the table, if no repository has
+// a contents index.
+bool rebuild_command_map() {
+    if (!load_repository_config()) return false;
+    const uint64_t key = command_sources_key();
+    std::vector<ContentsIndex> contents(repositories.size());
+    std::vector<CommandSource> sources;
+    for (std::size_t i = 0; i < repositories.size(); ++i) {
+        if (contents[i].open(repositories[i].contents_path)) sources.push_back({&contents[i], repositories[i].name});
+    }
+    const std::string path = get_commands_path();
+    std::string bytes;
+    if (sources.empty() || !build_command_map(sources, key, bytes)) {
+        // A table of repositories that are gone must not keep answering.
+        std::remove(path.c_str());
+        return false;
+    }
+    std::filesystem::create_directories(get_package_cache_dir());
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    bool written = false;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        written = static_cast<bool>(out.write(bytes.data(), static_cast<std::streamsize>(bytes.size())));
+    }
+    if (!written || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Map the command table, rebuilding it first when it is missing or was built
+// from another set of repositories or contents indexes.
+bool open_command_map(CommandMap& commands) {
+    if (!load_repository_config()) return false;
+    if (commands.open(get_commands_path()) && commands.sources_key() == command_sources_key()) return true;
+    return rebuild_command_map() && commands.open(get_commands_path());
+}
+
+// The command-not-found fast path: the repository configuration, a stat of
+// each contents index to check the table is current, then one mapped file and
+// a single probe.
+void handle_which_provides(const std::string& command) {
+    CommandMap commands;
+    if (!open_command_map(commands)) {
+        report("error", "No contents index available; run `fox update` (the repository must publish contents.idx).");
+        return;
+    }
+    std::vector<CommandProvider> providers;
+    if (!commands.find(command, providers)) {
+        report("error", "Command index is corrupt; run `fox update`.");
+        return;
+    }
+    if (ndjson_output) {
+        for (const CommandProvider& p : providers) {
+            emit({{"type", "provider"},
+                  {"command", command},
+                  {"package", std::string(p.package)},
+                  {"repository", std::string(p.repository)}});
+        }
+        return;
+    }
+    if (providers.empty()) {
+        std::cout << "No package provides the command '" << command << "'." << std::endl;
+        return;
+    }
+    std::cout << "Command '" << command << "' can be installed with:" << std::endl;
+    // Name the repositories only when the providers come from several.
+    bool tagged = std::any_of(providers.begin(), providers.end(), [&](const CommandProvider& p) {
+        return p.repository != providers.front().repository;
+    });
+    for (const CommandProvider& p : providers) {
+        std::cout << "  fox install " << p.package;
+        if (tagged) std::cout << "  [" << p.repository << "]";
+        std::cout << std::endl;
+    }
+}
+
+// Answered from each repository's contents.idx, so it covers packages that
+// are not installed and downloads nothing.
+void handle_provides(const std::string& path) {
+    if (!load_repository_config()) return;
+    bool merged = repositories.size() > 1;
+    bool any_index = false;
     bool found = false;
-    for (auto it = pkgs.begin(); it != pkgs.end(); ++it) {
-        const auto& meta = it.value();
-        std::string name = meta.value("name", "");
-        std::string desc = meta.value("description", "");
-        std::cout << "Checking package: " << name << " - " << desc << std::endl;
-        if (name.find(query) != std::string::npos || desc.find(query) != std::string::npos) {
-            std::cout << name << " (" << meta.value("version", "") << ") - " << desc << std::endl;
+    std::vector<uint32_t> ids;
+    for (const Repository& repo : repositories) {
+        ContentsIndex contents;
+        if (!contents.open(repo.contents_path)) continue;
+        any_index = true;
+        if (!contents.find(path, ids)) {
+            report("error", "Contents index of '" + repo.name + "' is corrupt; run `fox update`.");
+            continue;
+        }
+        for (uint32_t id : ids) {
             found = true;
+            if (ndjson_output) {
+                emit({{"type", "provider"},
+                      {"path", "/" + std::string(normalize_contents_path(path))},
+                      {"package", std::string(contents.package_name(id))},
+                      {"repository", repo.name}});
+                continue;
+            }
+            std::cout << contents.package_name(id);
+            if (merged) std::cout << " [" << repo.name << "]";
+            std::cout << ": /" << normalize_contents_path(path) << std::endl;
         }
     }
-    if (!found) {
-        std::cout << "No packages found matching '" << query << "'." << std::endl;
+    if (!any_index) {
+        report("error", "No contents index available; run `fox update` (the repository must publish contents.idx).");
+    } else if (!found && !ndjson_output) {
+        std::cout << "No package provides '" << path << "'." << std::endl;
+    }
+}
+
+const char* update_status_name(UpdateStatus status) {
+    switch (status) {
+        case UpdateStatus::Updated: return "updated";
+        case UpdateStatus::NotModified: return "not_modified";
+        case UpdateStatus::Removed: return "removed";
+        case UpdateStatus::Failed: break;
+    }
+    return "failed";
+}
+
+void handle_update(const std::string& url_override) {
+    if (!load_repository_config()) return;
+    if (!url_override.empty() && repositories.size() > 1) {
+        report("error", "--url cannot be used with several configured repositories.");
+        return;
     }
-}
\ No newline at end of file
+    bool updated = false;
+    bool contents_updated = false;
+    for (const Repository& repo : repositories) {
+        std::string url = url_override.empty() ? repo.url : url_override;
+        if (url.empty()) {
+            if (repositories.size() == 1) {
+                report("error", "No repository URL configured. Set \"repo_url\" in " + get_config_path() +
+                                    " or pass --url.");
+            } else {
+                report("error", "No URL configured for repository '" + repo.name + "'.");
+            }
+            continue;
+        }
+        if (!ndjson_output) {
+            if (repositories.size() == 1) {
+                std::cout << "Updating package index from " << url << "... " << std::flush;
+            } else {
+                std::cout << "Updating " << repo.name << " from " << url << "... " << std::flush;
+            }
+        }
+        UpdateResult result = update_repo_file(url, repo.repo_path, repo.state_dir);
+        UpdateResult contents;
+        if (result.status != UpdateStatus::Failed) {
+            contents = update_contents_file(url, repo.contents_path, repo.state_dir);
+            if (contents.status == UpdateStatus::Failed && !ndjson_output) {
+                std::cout << "(contents index not updated: " << contents.error << ") ";
+            }
+            if (contents.status == UpdateStatus::Removed && !ndjson_output) {
+                std::cout << "(contents index no longer published, removed) ";
+            }
+            contents_updated |= contents.status == UpdateStatus::Updated || contents.status == UpdateStatus::Removed;
+        }
+        updated |= result.status == UpdateStatus::Updated;
+        if (ndjson_output) {
+            // One record per repository once both files are fetched.
+            json record = {{"type", "update"}, {"repository", repo.name}, {"url", url},
+                           {"status", update_status_name(result.status)}};
+            if (result.status == UpdateStatus::Updated) record["source"] = result.source;
+            if (result.status == UpdateStatus::Failed) record["error"] = result.error;
+            if (result.status != UpdateStatus::Failed) {
+                record["contents"] = update_status_name(contents.status);
+                if (contents.status == UpdateStatus::Failed) record["contents_error"] = contents.error;
+            }
+            emit(record);
+            continue;
+        }
+        switch (result.status) {
+            case UpdateStatus::NotModified:
+            case UpdateStatus::Removed:
+                std::cout << "already up to date." << std::endl;
+                break;
+            case UpdateStatus::Failed:
+                std::cout << "failed." << std::endl;
+                std::cout << result.error << std::endl;
+                break;
+            case UpdateStatus::Updated:
+                std::cout << "done (" << result.source << ")." << std::endl;
+                break;
+        }
+    }
+    // Rebuild the binary index now rather than on the next install or search.
+    if (updated && !load_repo_db()) {
+        report("error", "Failed to index the new repo database");
+    }
+    // Likewise the command table, so command-not-found lookups stay a
+    // single probe.
+    CommandMap commands;
+    if (contents_updated) {
+        rebuild_command_map();
+    } else {
+        open_command_map(commands);
+    }
+}
+
+void handle_repo_publish(const std::string& new_repo, const std::string& repo_dir) {
+    std::filesystem::create_directories(repo_dir);
+    uint64_t generation = 0;
+    std::string error;
+    if (!publish_repo_generation(new_repo, repo_dir, generation, error)) {
+        report("error", "Failed to publish " + new_repo + ": " + error);
+        return;
+    }
+    if (ndjson_output) {
+        emit({{"type", "publish"}, {"directory", repo_dir}, {"generation", generation}});
+        return;
+    }
+    std::cout << "Repository " << repo_dir << " is at generation " << generation << "." << std::endl;
+}
+
+void handle_repo_index(const std::string& dir, const RepoGenerateOptions& options) {
+    RepoGenerateStats stats;
+    std::string error;
+    bool ok = generate_repo_index(dir, options, stats, error);
+    for (const std::string& problem : stats.problems) {
+        report("warning", "Skipped " + problem);
+    }
+    if (!ok) {
+        report("error", "Failed to index " + dir + ": " + error);
+        return;
+    }
+    if (ndjson_output) {
+        emit({{"type", "index"},
+              {"directory", dir},
+              {"packages", stats.packages},
+              {"scanned", stats.scanned},
+              {"unchanged", stats.reused},
+              {"removed", stats.removed},
+              {"changed", stats.changed}});
+        return;
+    }
+    std::cout << "Indexed " << stats.packages << " packages (" << stats.scanned << " scanned, "
+              << stats.reused << " unchanged, " << stats.removed << " removed)";
+    std::cout << (stats.changed ? "." : "; repo.json is already up to date.") << std::endl;
+}
+
+// --- fox query ---
+//
+// Requests are JSON objects, one per line:
+//   {"op": "search", "query": "editor", "limit": 20, "mode": "substring"}
+//   {"op": "info", "name": "vim"}
+//   {"op": "resolve", "names": ["vim", "git"]}
+// Each gets exactly one response line, {"ok": true, ...} or {"ok": false,
+// "error": ...}, carrying the request's "id" if it had one. The index is
+// loaded once for the whole stream.
+
+json query_error(const std::string& message) {
+    return {{"ok", false}, {"error", message}};
+}
+
+// Read an optional string member; false if it is present but not a string.
+bool string_member(const json& request, const char* key, std::string& value) {
+    auto it = request.find(key);
+    if (it == request.end()) return true;
+    if (!it->is_string()) return false;
+    value = it->get<std::string>();
+    return true;
+}
+
+json query_search(const json& request) {
+    std::string query;
+    std::string mode = "words";
+    if (!string_member(request, "query", query) || query.empty()) return query_error("search needs a \"query\" string");
+    if (!string_member(request, "mode", mode)) return query_error("\"mode\" must be a string");
+    std::size_t limit = 20;
+    if (auto it = request.find("limit"); it != request.end()) {
+        if (!it->is_number_unsigned()) return query_error("\"limit\" must be a non-negative integer");
+        limit = it->get<std::size_t>();
+    }
+    bool substring = mode == "substring";
+    bool ignore_case = mode == "ignore_case";
+    bool fuzzy = mode == "fuzzy";
+    if (!substring && !ignore_case && !fuzzy && mode != "words") {
+        return query_error("unknown search mode '" + mode + "' (words, substring, ignore_case or fuzzy)");
+    }
+    Query structured;
+    bool use_query = is_query_search(query, substring, ignore_case, fuzzy);
+    std::string error;
+    if (use_query && !parse_query(query, structured, error)) return query_error("invalid query: " + error);
+    std::vector<SearchHit> hits;
+    std::size_t total = 0;
+    if (!search_loaded_index(query, use_query ? &structured : nullptr, limit, substring, ignore_case, fuzzy, hits, total)) {
+        return query_error("search index unavailable");
+    }
+    json results = json::array();
+    for (const SearchHit& hit : hits) {
+        json record = package_record(repo_index.package(hit.package));
+        record.erase("type");
+        results.push_back(std::move(record));
+    }
+    return {{"ok", true}, {"total", total}, {"results", std::move(results)}};
+}
+
+json query_info(const json& request) {
+    std::string name;
+    if (!string_member(request, "name", name) || name.empty()) return query_error("info needs a \"name\" string");
+    uint32_t id = repo_index.find(name);
+    if (id == REPO_INDEX_NPOS) return query_error("package not found: " + name);
+    PackageView meta = repo_index.package(id);
+    json record = package_record(meta);
+    record.erase("type");
+    record["arch"] = std::string(meta.arch);
+    record["license"] = std::string(meta.license);
+    record["maintainer"] = std::string(meta.maintainer);
+    record["url"] = std::string(meta.url);
+    json depends = json::array();
+    json conflicts = json::array();
+    json provides = json::array();
+    for (uint32_t i = 0; i < meta.deps_count; ++i) {
+        DependencyView dep = repo_index.dependency(meta, i);
+        if (dep.provider()) continue;
+        if (dep.provides()) {
+            provides.push_back(std::string(dep.raw));
+        } else if (dep.conflict()) {
+            conflicts.push_back(std::string(dep.raw));
+        } else if (dep.alternative() && !depends.empty()) {
+            depends.back() = depends.back().get<std::string>() + " | " + std::string(dep.raw);
+        } else {
+            depends.push_back(std::string(dep.raw));
+        }
+    }
+    record["depends"] = std::move(depends);
+    record["conflicts"] = std::move(conflicts);
+    record["provides"] = std::move(provides);
+    if (const DependencyGraph* graph = dependency_graph_of_index()) {
+        json required_by = json::array();
+        for (uint32_t dependent : graph->dependents(id)) required_by.push_back(std::string(repo_index.name(dependent)));
+        record["required_by"] = std::move(required_by);
+    }
+    auto installed = installed_packages.find(name);
+    record["installed"] = installed != installed_packages.end();
+    if (installed != installed_packages.end() && !installed->second.version.empty()) {
+        record["installed_version"] = installed->second.version;
+    }
+    return {{"ok", true}, {"package", std::move(record)}};
+}
+
+// Every package names need, directly or not; with "reverse", every package
+// that needs one of them.
+json query_depends(const json& request) {
+    auto it = request.find("names");
+    if (it == request.end() || !it->is_array()) return query_error("depends needs a \"names\" array");
+    bool reverse = false;
+    if (auto flag = request.find("reverse"); flag != request.end()) {
+        if (!flag->is_boolean()) return query_error("\"reverse\" must be a boolean");
+        reverse = flag->get<bool>();
+    }
+    const DependencyGraph* graph = dependency_graph_of_index();
+    if (!graph) return query_error("the dependency graph cannot be read");
+    std::vector<uint32_t> roots;
+    json not_found = json::array();
+    for (const json& entry : *it) {
+        if (!entry.is_string()) return query_error("\"names\" must hold strings");
+        uint32_t id = repo_index.find(entry.get_ref<const std::string&>());
+        if (id == REPO_INDEX_NPOS) {
+            not_found.push_back(entry);
+        } else {
+            roots.push_back(id);
+        }
+    }
+    PackageSet closure = graph->closure(roots, reverse);
+    PackageSet requested(closure.size());
+    for (uint32_t id : roots) requested.insert(id);
+    json packages = json::array();
+    for (uint32_t id : closure.ids()) {
+        if (!requested.contains(id)) packages.push_back(std::string(repo_index.name(id)));
+    }
+    return {{"ok", true}, {"packages", std::move(packages)}, {"not_found", std::move(not_found)}};
+}
+
+// The install plan `fox install` would carry out for names.
+json query_resolve(const json& request) {
+    auto it = request.find("names");
+    if (it == request.end() || !it->is_array()) return query_error("resolve needs a \"names\" array");
+    std::vector<uint32_t> requested;
+    json not_found = json::array();
+    json installed = json::array();
+    for (const json& entry : *it) {
+        if (!entry.is_string()) return query_error("\"names\" must hold strings");
+        const std::string& name = entry.get_ref<const std::string&>();
+        uint32_t id = repo_index.find(name);
+        if (id == REPO_INDEX_NPOS) {
+            not_found.push_back(name);
+        } else if (installed_packages.count(name)) {
+            installed.push_back(name);
+        } else {
+            requested.push_back(id);
+        }
+    }
+    InstallPlan plan;
+    plan_install(requested, plan);
+    json packages = json::array();
+    for (uint32_t id : plan.packages) {
+        json record = package_record(repo_index.package(id));
+        record.erase("type");
+        record.erase("description");
+        packages.push_back(std::move(record));
+    }
+    json problems = json::array();
+    for (const ResolveProblem& problem : plan.problems) {
+        problems.push_back(
+            {{"package", problem.package}, {"message", problem.message}, {"explanation", problem.explanation}});
+    }
+    json cycles = json::array();
+    for (const std::vector<uint32_t>& cycle : plan.cycles) {
+        json names = json::array();
+        for (uint32_t id : cycle) names.push_back(std::string(repo_index.name(id)));
+        cycles.push_back(std::move(names));
+    }
+    return {{"ok", true},
+            {"plan", std::move(packages)},
+            {"problems", std::move(problems)},
+            {"cycles", std::move(cycles)},
+            {"installed", std::move(installed)},
+            {"not_found", std::move(not_found)}};
+}
+
+json answer_query(const json& request) {
+    if (!request.is_object()) return query_error("request must be a JSON object");
+    std::string op;
+    if (!string_member(request, "op", op)) return query_error("\"op\" must be a string");
+    json response;
+    if (op == "search") {
+        response = query_search(request);
+    } else if (op == "info") {
+        response = query_info(request);
+    } else if (op == "resolve") {
+        response = query_resolve(request);
+    } else if (op == "depends") {
+        response = query_depends(request);
+    } else {
+        response = query_error("unknown op '" + op + "' (search, info, resolve or depends)");
+    }
+    if (auto id = request.find("id"); id != request.end()) response["id"] = *id;
+    return response;
+}
+
+void handle_query(const std::vector<std::string>& requests, bool from_stdin) {
+    // Responses are always NDJSON, and so are errors from loading the index.
+    ndjson_output = true;
+    std::ios::sync_with_stdio(false);
+    if (requests.empty() && !from_stdin) {
+        report("error", "Pass requests as arguments or use --stdin.");
+        return;
+    }
+    if (!load_repo_db()) return;
+    load_installed_packages();
+
+    for (const std::string& line : requests) {
+        json request = json::parse(line, nullptr, false);
+        emit(request.is_discarded() ? query_error("invalid JSON") : answer_query(request));
+    }
+    if (!from_stdin) return;
+    std::cout.flush();
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        json request = json::parse(line, nullptr, false);
+        refresh_index();
+        emit(request.is_discarded() ? query_error("invalid JSON") : answer_query(request));
+        // Flush once the pending input is answered: a piped batch is written
+        // in large chunks, while an interactive caller waiting on each answer
+        // sees it immediately.
+        if (std::cin.rdbuf()->in_avail() <= 0) std::cout.flush();
+    }
+}
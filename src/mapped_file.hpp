@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+
+// Read-only, private memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Returns false if the file cannot be opened or mapped. Empty files map
+    // successfully to an empty view.
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return open_; }
+
+    const char* data() const { return static_cast<const char*>(base_); }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data(), size_); }
+
+    // fstat() of the descriptor that was mapped, so it describes exactly the
+    // bytes in view() even if the path has since been replaced.
+    const struct stat& file_stat() const { return stat_; }
+
+private:
+    void* base_ = nullptr;
+    std::size_t size_ = 0;
+    struct stat stat_ {};
+    bool open_ = false;
+};
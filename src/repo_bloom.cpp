@@ -0,0 +1,46 @@
+#include "repo_bloom.hpp"
+
+#include "content_hash.hpp"
+
+namespace {
+
+// Odd multipliers spreading the low half of the hash over the eight words.
+constexpr uint32_t SALTS[8] = {0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+                               0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+// The high half of the hash picks the block, the low half the bits in it.
+uint32_t block_of(uint64_t hash, uint32_t block_count) {
+    return static_cast<uint32_t>(((hash >> 32) * block_count) >> 32);
+}
+
+BloomBlock block_mask(uint64_t hash) {
+    BloomBlock mask;
+    uint32_t key = static_cast<uint32_t>(hash);
+    for (int i = 0; i < 8; ++i) mask.words[i] = 1u << ((key * SALTS[i]) >> 27);
+    return mask;
+}
+
+} // namespace
+
+std::string build_bloom_filter(const std::vector<std::string_view>& keys) {
+    uint64_t bits = uint64_t(keys.size()) * BLOOM_BITS_PER_KEY;
+    uint32_t block_count = static_cast<uint32_t>(bits / 256 + 1);
+    std::vector<BloomBlock> blocks(block_count, BloomBlock{});
+    for (std::string_view key : keys) {
+        uint64_t hash = content_hash64(key);
+        BloomBlock mask = block_mask(hash);
+        BloomBlock& block = blocks[block_of(hash, block_count)];
+        for (int i = 0; i < 8; ++i) block.words[i] |= mask.words[i];
+    }
+    return std::string(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(BloomBlock));
+}
+
+bool bloom_may_contain(const BloomBlock* blocks, uint32_t block_count, std::string_view key) {
+    if (block_count == 0) return true;
+    uint64_t hash = content_hash64(key);
+    BloomBlock mask = block_mask(hash);
+    const BloomBlock& block = blocks[block_of(hash, block_count)];
+    uint32_t missing = 0;
+    for (int i = 0; i < 8; ++i) missing |= mask.words[i] & ~block.words[i];
+    return missing == 0;
+}
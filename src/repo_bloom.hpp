@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Negative lookups by package name.
+//
+// Every index directory carries a split-block Bloom filter of its package
+// names, so a name the repository does not have is rejected before any shard
+// is mapped. The filter is an array of 256-bit blocks: a name's hash picks
+// one block and sets one bit in each of its eight 32-bit words, so a probe
+// reads a single cache line however large the repository is. At
+// BLOOM_BITS_PER_KEY bits per name about one absent name in a thousand still
+// gets through and falls back to the binary search.
+
+constexpr uint32_t BLOOM_BITS_PER_KEY = 16;
+
+struct BloomBlock {
+    uint32_t words[8];
+};
+
+// Serialize a filter holding keys; always at least one block.
+std::string build_bloom_filter(const std::vector<std::string_view>& keys);
+
+// False if key was certainly not among the keys the filter was built from.
+bool bloom_may_contain(const BloomBlock* blocks, uint32_t block_count, std::string_view key);
@@ -0,0 +1,206 @@
+#include "repo_commands.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "content_hash.hpp"
+
+namespace {
+
+// Average commands per bucket. With the slot table about 12% larger than the
+// command count, displacements for even the last buckets are found quickly.
+constexpr uint32_t KEYS_PER_BUCKET = 4;
+constexpr uint32_t MAX_DISPLACEMENT = 1u << 16;
+constexpr uint64_t MAX_SEEDS = 64;
+
+struct CommandHash {
+    uint64_t bucket;
+    uint64_t slot;
+    uint64_t step;
+};
+
+CommandHash hash_command(std::string_view command, uint64_t seed) {
+    uint64_t a = content_hash64(command, seed);
+    uint64_t b = content_hash64(command, seed ^ 0x9e3779b97f4a7c15ull);
+    return {a, b, (a >> 32) | 1};
+}
+
+uint32_t slot_of(const CommandHash& h, uint32_t displacement, uint32_t slot_count) {
+    return static_cast<uint32_t>((h.slot + displacement * h.step) % slot_count);
+}
+
+// Pick a displacement per bucket, biggest buckets first, so every command
+// lands in its own slot. Fails if some bucket cannot be placed.
+bool place(const std::vector<CommandHash>& hashes, uint32_t bucket_count, uint32_t slot_count,
+           std::vector<uint32_t>& displacements, std::vector<uint32_t>& slot_keys) {
+    std::vector<std::vector<uint32_t>> buckets(bucket_count);
+    for (uint32_t key = 0; key < hashes.size(); ++key) buckets[hashes[key].bucket % bucket_count].push_back(key);
+    std::vector<uint32_t> order(bucket_count);
+    for (uint32_t b = 0; b < bucket_count; ++b) order[b] = b;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t x, uint32_t y) { return buckets[x].size() > buckets[y].size(); });
+
+    displacements.assign(bucket_count, 0);
+    slot_keys.assign(slot_count, UINT32_MAX);
+    std::vector<uint32_t> slots;
+    for (uint32_t b : order) {
+        const std::vector<uint32_t>& keys = buckets[b];
+        if (keys.empty()) break;
+        bool placed = false;
+        for (uint32_t d = 0; d < MAX_DISPLACEMENT && !placed; ++d) {
+            slots.clear();
+            placed = true;
+            for (uint32_t key : keys) {
+                uint32_t slot = slot_of(hashes[key], d, slot_count);
+                if (slot_keys[slot] != UINT32_MAX || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (placed) {
+                displacements[b] = d;
+                for (std::size_t i = 0; i < keys.size(); ++i) slot_keys[slots[i]] = keys[i];
+            }
+        }
+        if (!placed) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string_view command_name(std::string_view path) {
+    path = normalize_contents_path(path);
+    std::size_t slash = path.rfind('/');
+    if (slash == std::string_view::npos || slash + 1 == path.size()) return {};
+    std::string_view dir = path.substr(0, slash);
+    std::size_t parent = dir.rfind('/');
+    std::string_view last = parent == std::string_view::npos ? dir : dir.substr(parent + 1);
+    if (last != "bin" && last != "sbin") return {};
+    return path.substr(slash + 1);
+}
+
+bool build_command_map(const std::vector<CommandSource>& sources, uint64_t sources_key, std::string& bytes) {
+    // Paths are decoded into a scratch buffer, so command names are copied;
+    // package and repository names point into the mapped contents indexes.
+    std::map<std::string, std::vector<CommandProvider>, std::less<>> commands;
+    for (const CommandSource& source : sources) {
+        bool ok = source.contents->for_each([&](std::string_view path, uint32_t package) {
+            std::string_view command = command_name(path);
+            if (command.empty()) return true;
+            auto it = commands.find(command);
+            if (it == commands.end()) it = commands.emplace(std::string(command), std::vector<CommandProvider>()).first;
+            CommandProvider provider{source.contents->package_name(package), source.repository};
+            bool listed = std::any_of(it->second.begin(), it->second.end(), [&](const CommandProvider& p) {
+                return p.package == provider.package && p.repository == provider.repository;
+            });
+            if (!listed) it->second.push_back(provider);
+            return true;
+        });
+        if (!ok) return false;
+    }
+
+    std::string strings;
+    std::vector<CommandSlot> entries;
+    std::vector<CommandHash> hashes;
+    entries.reserve(commands.size());
+    for (const auto& [command, providers] : commands) {
+        CommandSlot entry{};
+        entry.command = {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(command.size())};
+        strings.append(command);
+        uint32_t begin = static_cast<uint32_t>(strings.size());
+        for (const CommandProvider& p : providers) {
+            strings.append(p.package);
+            strings.push_back('\t');
+            strings.append(p.repository);
+            strings.push_back('\n');
+        }
+        entry.providers = {begin, static_cast<uint32_t>(strings.size() - begin)};
+        entries.push_back(entry);
+    }
+
+    const uint32_t count = static_cast<uint32_t>(entries.size());
+    const uint32_t bucket_count = count / KEYS_PER_BUCKET + 1;
+    const uint32_t slot_count = count + count / 8 + 1;
+    std::vector<uint32_t> displacements;
+    std::vector<uint32_t> slot_keys;
+    uint64_t seed = 1;
+    for (;; ++seed) {
+        if (seed > MAX_SEEDS) return false;
+        hashes.clear();
+        for (const auto& entry : commands) hashes.push_back(hash_command(entry.first, seed));
+        if (place(hashes, bucket_count, slot_count, displacements, slot_keys)) break;
+    }
+
+    std::vector<CommandSlot> slots(slot_count, CommandSlot{});
+    for (uint32_t s = 0; s < slot_count; ++s) {
+        if (slot_keys[s] != UINT32_MAX) slots[s] = entries[slot_keys[s]];
+    }
+
+    CommandsHeader header{};
+    std::memcpy(header.magic, REPO_COMMANDS_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.command_count = count;
+    header.seed = seed;
+    header.sources_key = sources_key;
+    header.bucket_count = bucket_count;
+    header.slot_count = slot_count;
+    header.buckets_offset = sizeof(CommandsHeader);
+    header.slots_offset = header.buckets_offset + (uint64_t(bucket_count) * sizeof(uint32_t) + 7) / 8 * 8;
+    header.strings_offset = header.slots_offset + uint64_t(slot_count) * sizeof(CommandSlot);
+    header.strings_size = strings.size();
+
+    bytes.clear();
+    bytes.reserve(header.strings_offset + strings.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(displacements.data()), displacements.size() * sizeof(uint32_t));
+    bytes.resize(header.slots_offset, '\0');
+    bytes.append(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(CommandSlot));
+    bytes.append(strings);
+    return true;
+}
+
+bool CommandMap::open(const std::string& path) {
+    header_ = nullptr;
+    if (!file_.open(path) || file_.size() < sizeof(CommandsHeader)) return false;
+    const auto* header = reinterpret_cast<const CommandsHeader*>(file_.data());
+    if (std::memcmp(header->magic, REPO_COMMANDS_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_INDEX_VERSION || header->bucket_count == 0 || header->slot_count == 0 ||
+        header->buckets_offset + uint64_t(header->bucket_count) * sizeof(uint32_t) > header->slots_offset ||
+        header->slots_offset + uint64_t(header->slot_count) * sizeof(CommandSlot) > header->strings_offset ||
+        header->strings_offset + header->strings_size > file_.size()) {
+        file_.close();
+        return false;
+    }
+    header_ = header;
+    buckets_ = reinterpret_cast<const uint32_t*>(file_.data() + header->buckets_offset);
+    slots_ = reinterpret_cast<const CommandSlot*>(file_.data() + header->slots_offset);
+    strings_ = file_.data() + header->strings_offset;
+    return true;
+}
+
+bool CommandMap::find(std::string_view command, std::vector<CommandProvider>& providers) const {
+    providers.clear();
+    if (!header_) return false;
+    CommandHash h = hash_command(command, header_->seed);
+    uint32_t displacement = buckets_[h.bucket % header_->bucket_count];
+    const CommandSlot& slot = slots_[slot_of(h, displacement, header_->slot_count)];
+    if (uint64_t(slot.command.offset) + slot.command.length > header_->strings_size ||
+        uint64_t(slot.providers.offset) + slot.providers.length > header_->strings_size) {
+        return false;
+    }
+    if (slot.command.length == 0 || std::string_view(strings_ + slot.command.offset, slot.command.length) != command) {
+        return true;
+    }
+    std::string_view list(strings_ + slot.providers.offset, slot.providers.length);
+    while (!list.empty()) {
+        std::size_t tab = list.find('\t');
+        std::size_t end = list.find('\n');
+        if (tab == std::string_view::npos || end == std::string_view::npos || tab > end) return false;
+        providers.push_back({list.substr(0, tab), list.substr(tab + 1, end - tab - 1)});
+        list.remove_prefix(end + 1);
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "repo_contents.hpp"
+#include "repo_index.hpp"
+
+// Command-not-found lookups (`fox which-provides`).
+//
+// Shells call this on every mistyped command, so it must not load anything
+// but one small file. After `fox update` the contents indexes of all
+// repositories are reduced to the executables they ship (files directly in a
+// bin/ or sbin/ directory) and written as a perfect hash table from command
+// name to the packages providing it, in cache/commands.idx:
+//
+//   CommandsHeader
+//   uint32_t[bucket_count]      displacement of each bucket
+//   CommandSlot[slot_count]     empty slots have an empty key
+//   char[strings_size]          keys and provider lists
+//
+// The table uses hash-and-displace: a command's first hash picks a bucket,
+// and the bucket's displacement, chosen at build time so that no two
+// commands collide, turns its second hash into a slot. A lookup is two
+// hashes and a single probe, then one key compare.
+//
+// The header records a key of the repository list, priorities and contents
+// indexes the table was built from; a table whose key no longer matches the
+// configuration is rebuilt before it is used.
+
+constexpr char REPO_COMMANDS_MAGIC[8] = {'F', 'O', 'X', 'C', 'M', 'D', 'S', '\0'};
+
+struct CommandsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t command_count;
+    uint64_t seed;
+    uint64_t sources_key;  // identity of the repositories it was built from
+    uint32_t bucket_count;
+    uint32_t slot_count;
+    uint64_t buckets_offset;
+    uint64_t slots_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct CommandSlot {
+    StrRef command;
+    StrRef providers;  // "package\trepository\n" per provider
+};
+
+struct CommandProvider {
+    std::string_view package;
+    std::string_view repository;
+};
+
+struct CommandSource {
+    const ContentsIndex* contents;
+    std::string_view repository;
+};
+
+// Command name of an executable path ("usr/bin/vim" -> "vim"), or an empty
+// view when the path is not directly inside a bin/ or sbin/ directory.
+std::string_view command_name(std::string_view path);
+
+// Serialize the command table. sources are in priority order; a command's
+// providers are listed in that order. sources_key is stored in the header for
+// the caller to tell whether the table still matches its repositories.
+bool build_command_map(const std::vector<CommandSource>& sources, uint64_t sources_key, std::string& bytes);
+
+class CommandMap {
+public:
+    bool open(const std::string& path);
+    std::size_t size() const { return header_ ? header_->command_count : 0; }
+    uint64_t sources_key() const { return header_ ? header_->sources_key : 0; }
+
+    // Packages providing command, highest priority first.
+    bool find(std::string_view command, std::vector<CommandProvider>& providers) const;
+
+private:
+    MappedFile file_;
+    const CommandsHeader* header_ = nullptr;
+    const uint32_t* buckets_ = nullptr;
+    const CommandSlot* slots_ = nullptr;
+    const char* strings_ = nullptr;
+};
@@ -0,0 +1,137 @@
+#include "repo_complete.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+#include "mapped_file.hpp"
+#include "repo_fuzzy.hpp"
+
+namespace {
+
+std::size_t common_prefix(std::string_view a, std::string_view b) {
+    std::size_t n = std::min(a.size(), b.size());
+    std::size_t i = 0;
+    while (i < n && a[i] == b[i]) ++i;
+    return i;
+}
+
+} // namespace
+
+std::string build_name_trie(const std::vector<std::string_view>& names) {
+    struct Pending {
+        uint32_t node;
+        uint32_t lo, hi;     // names below the node
+        std::size_t depth;   // length of the prefix they share
+    };
+    std::vector<TrieNode> nodes;
+    std::string labels;
+    nodes.push_back({{0, 0}, 0, 0, 0, static_cast<uint32_t>(names.size())});
+    // Breadth-first, so each node's children are appended in one run.
+    std::deque<Pending> queue;
+    queue.push_back({0, 0, static_cast<uint32_t>(names.size()), 0});
+    while (!queue.empty()) {
+        Pending p = queue.front();
+        queue.pop_front();
+        uint32_t i = p.lo;
+        // A name equal to the prefix itself sorts first and ends here.
+        if (i < p.hi && names[i].size() == p.depth) ++i;
+        nodes[p.node].first_child = static_cast<uint32_t>(nodes.size());
+        while (i < p.hi) {
+            char c = names[i][p.depth];
+            uint32_t j = i + 1;
+            while (j < p.hi && names[j][p.depth] == c) ++j;
+            // Sorted input: the first and last name bound the group's prefix.
+            std::size_t depth = common_prefix(names[i], names[j - 1]);
+            StrRef label{static_cast<uint32_t>(labels.size()), static_cast<uint32_t>(depth - p.depth)};
+            labels.append(names[i].substr(p.depth, depth - p.depth));
+            uint32_t child = static_cast<uint32_t>(nodes.size());
+            nodes.push_back({label, 0, 0, i, j - i});
+            ++nodes[p.node].child_count;
+            queue.push_back({child, i, j, depth});
+            i = j;
+        }
+    }
+
+    TrieHeader header{};
+    std::memcpy(header.magic, REPO_TRIE_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.package_count = static_cast<uint32_t>(names.size());
+    header.node_count = static_cast<uint32_t>(nodes.size());
+    header.nodes_offset = sizeof(TrieHeader);
+    header.labels_offset = header.nodes_offset + nodes.size() * sizeof(TrieNode);
+    header.labels_size = labels.size();
+
+    std::string bytes;
+    bytes.reserve(header.labels_offset + labels.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(TrieNode));
+    bytes.append(labels);
+    return bytes;
+}
+
+bool complete_names(const RepoIndex& index, std::string_view prefix, std::size_t limit,
+                    std::vector<std::string>& names) {
+    names.clear();
+    MappedFile trie;
+    if (!trie.open(index.trie_path()) || trie.size() < sizeof(TrieHeader)) return false;
+    const auto* header = reinterpret_cast<const TrieHeader*>(trie.data());
+    if (std::memcmp(header->magic, REPO_TRIE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_INDEX_VERSION || header->package_count != index.size() || header->node_count == 0 ||
+        header->nodes_offset + uint64_t(header->node_count) * sizeof(TrieNode) > header->labels_offset ||
+        header->labels_offset + header->labels_size > trie.size()) {
+        return false;
+    }
+    const auto* nodes = reinterpret_cast<const TrieNode*>(trie.data() + header->nodes_offset);
+    const char* labels = trie.data() + header->labels_offset;
+    auto label_of = [&](const TrieNode& node) {
+        return std::string_view(labels + node.label.offset, node.label.length);
+    };
+
+    const TrieNode* node = &nodes[0];
+    std::size_t matched = 0;
+    while (matched < prefix.size()) {
+        if (uint64_t(node->first_child) + node->child_count > header->node_count) return false;
+        const TrieNode* first = nodes + node->first_child;
+        const TrieNode* last = first + node->child_count;
+        for (const TrieNode* child = first; child != last; ++child) {
+            if (uint64_t(child->label.offset) + child->label.length > header->labels_size ||
+                child->label.length == 0) {
+                return false;
+            }
+        }
+        unsigned char c = static_cast<unsigned char>(prefix[matched]);
+        const TrieNode* child = std::lower_bound(first, last, c, [&](const TrieNode& n, unsigned char key) {
+            return static_cast<unsigned char>(labels[n.label.offset]) < key;
+        });
+        if (child == last || static_cast<unsigned char>(labels[child->label.offset]) != c) return true;
+        std::string_view label = label_of(*child);
+        std::string_view rest = prefix.substr(matched);
+        std::size_t n = std::min(label.size(), rest.size());
+        if (label.compare(0, n, rest.substr(0, n)) != 0) return true;
+        matched += n;
+        node = child;
+    }
+
+    // List the node's id range from the name table.
+    MappedFile table;
+    if (!table.open(index.names_path()) || table.size() < sizeof(NameTableHeader)) return false;
+    const auto* names_header = reinterpret_cast<const NameTableHeader*>(table.data());
+    if (std::memcmp(names_header->magic, REPO_NAMES_MAGIC, sizeof(names_header->magic)) != 0 ||
+        names_header->version != REPO_INDEX_VERSION || names_header->package_count != index.size() ||
+        names_header->offsets_offset + (uint64_t(names_header->package_count) + 1) * sizeof(uint32_t) >
+            names_header->blob_offset ||
+        names_header->blob_offset + names_header->blob_size > table.size() ||
+        uint64_t(node->first_package) + node->package_count > names_header->package_count) {
+        return false;
+    }
+    const auto* offsets = reinterpret_cast<const uint32_t*>(table.data() + names_header->offsets_offset);
+    const char* blob = table.data() + names_header->blob_offset;
+    std::size_t count = limit ? std::min<std::size_t>(limit, node->package_count) : node->package_count;
+    names.reserve(count);
+    for (uint32_t id = node->first_package; id < node->first_package + count; ++id) {
+        if (offsets[id] > offsets[id + 1] || offsets[id + 1] > names_header->blob_size) return false;
+        names.emplace_back(blob + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+    return true;
+}
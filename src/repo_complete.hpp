@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "repo_index.hpp"
+
+// Package name completion for the shell.
+//
+// Completion runs on every <TAB>, so it must answer from a file that needs no
+// parsing: a radix trie over the sorted package names. Each node stores the
+// edge label leading into it and the range of package ids below it (names
+// are sorted, so every prefix covers a contiguous range); its children are
+// stored next to each other, sorted by the first byte of their labels.
+//
+//   TrieHeader
+//   TrieNode[node_count]   node 0 is the root, children laid out breadth-first
+//   char[labels_size]      edge labels
+//
+// A lookup walks one edge per distinct branching point of the prefix and
+// then lists the names of the node's id range from the packed name table
+// (see repo_fuzzy.hpp).
+
+constexpr char REPO_TRIE_MAGIC[8] = {'F', 'O', 'X', 'T', 'R', 'I', 'E', '\0'};
+
+struct TrieHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    uint32_t node_count;
+    uint32_t reserved;
+    uint64_t nodes_offset;
+    uint64_t labels_offset;
+    uint64_t labels_size;
+};
+
+struct TrieNode {
+    StrRef label;            // within the labels, leading into this node
+    uint32_t first_child;    // children are nodes [first_child, first_child + child_count)
+    uint32_t child_count;
+    uint32_t first_package;  // names below this node: [first_package, first_package + package_count)
+    uint32_t package_count;
+};
+
+// Serialize the trie over names, which must be sorted and unique.
+std::string build_name_trie(const std::vector<std::string_view>& names);
+
+// Names starting with prefix, in name order, at most limit of them (0 for
+// no limit). Returns false if the trie or the name table cannot be read.
+bool complete_names(const RepoIndex& index, std::string_view prefix, std::size_t limit,
+                    std::vector<std::string>& names);
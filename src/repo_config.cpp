@@ -0,0 +1,87 @@
+#include "repo_config.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+// Repository names become file names, so keep them to a safe alphabet.
+bool valid_repository_name(const std::string& name) {
+    if (name.empty() || name[0] == '.') return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '-' || c == '_' || c == '.';
+    });
+}
+
+} // namespace
+
+bool load_repositories(const std::string& fox_dir, const std::string& cache_dir,
+                       std::vector<Repository>& out, std::string& error) {
+    out.clear();
+    const std::string config_path = fox_dir + "/config.json";
+    json config = json::object();
+    std::ifstream config_file(config_path);
+    if (config_file.is_open()) {
+        config = json::parse(config_file, nullptr, false);
+        if (config.is_discarded() || !config.is_object()) {
+            error = config_path + " is not a JSON object";
+            return false;
+        }
+    }
+
+    if (!config.contains("repositories")) {
+        Repository repo;
+        repo.name = "main";
+        const char* env = getenv("FOX_REPO_URL");
+        repo.url = env && *env ? env : config.value("repo_url", "");
+        repo.repo_path = fox_dir + "/repo.json";
+        repo.index_path = cache_dir + "/repo.idx";
+        repo.contents_path = fox_dir + "/contents.idx";
+        repo.state_dir = cache_dir;
+        out.push_back(repo);
+        return true;
+    }
+
+    const json& list = config["repositories"];
+    if (!list.is_array() || list.empty()) {
+        error = "\"repositories\" in " + config_path + " must be a non-empty array";
+        return false;
+    }
+    std::set<std::string> seen;
+    for (const json& entry : list) {
+        if (!entry.is_object() || !entry.contains("name") || !entry["name"].is_string()) {
+            error = "every entry of \"repositories\" needs a \"name\"";
+            return false;
+        }
+        Repository repo;
+        repo.name = entry["name"].get<std::string>();
+        if (!valid_repository_name(repo.name)) {
+            error = "invalid repository name '" + repo.name + "'";
+            return false;
+        }
+        if (!seen.insert(repo.name).second) {
+            error = "repository '" + repo.name + "' is configured twice";
+            return false;
+        }
+        if (entry.contains("url") && entry["url"].is_string()) repo.url = entry["url"].get<std::string>();
+        if (entry.contains("priority") && entry["priority"].is_number_integer()) {
+            repo.priority = entry["priority"].get<int>();
+        }
+        repo.repo_path = fox_dir + "/repos/" + repo.name + "/repo.json";
+        repo.index_path = cache_dir + "/repos/" + repo.name + ".idx";
+        repo.contents_path = fox_dir + "/repos/" + repo.name + "/contents.idx";
+        repo.state_dir = cache_dir + "/repos/" + repo.name;
+        out.push_back(repo);
+    }
+    std::stable_sort(out.begin(), out.end(), [](const Repository& a, const Repository& b) {
+        return a.priority > b.priority;
+    });
+    return true;
+}
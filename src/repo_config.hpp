@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Configured package repositories.
+//
+// ~/.fox/config.json may list several repositories:
+//
+//   {"repositories": [
+//       {"name": "base",     "url": "https://.../base/repo.json",     "priority": 0},
+//       {"name": "internal", "url": "https://.../internal/repo.json", "priority": 10},
+//       {"name": "hotfix",   "url": "https://.../hotfix/repo.json",   "priority": 20}]}
+//
+// When a package name appears in more than one repository, the one with the
+// highest priority wins; on a tie the repository listed first wins. Without a
+// "repositories" list fox uses a single repository named "main" kept in the
+// original places (~/.fox/repo.json, fetched from "repo_url" or
+// $FOX_REPO_URL).
+
+struct Repository {
+    std::string name;
+    std::string url;
+    int priority = 0;
+    std::string repo_path;   // local copy of its repo.json
+    std::string index_path;  // binary index built from repo_path
+    std::string contents_path;  // file contents index fetched with repo_path
+    std::string state_dir;   // ETag and other `fox update` state
+};
+
+// Read the repository list from <fox_dir>/config.json, ordered from highest
+// to lowest priority. cache_dir is where indexes and update state are kept.
+// Returns false, with error set, when the configuration is unusable.
+bool load_repositories(const std::string& fox_dir, const std::string& cache_dir,
+                       std::vector<Repository>& out, std::string& error);
@@ -0,0 +1,246 @@
+#include "repo_contents.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "contents.idx is little-endian and read in place");
+
+namespace {
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) return false;
+        uint8_t byte = *p++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+struct Entry {
+    std::string_view path;
+    uint32_t package;
+};
+
+// Sequential decoder over one block.
+class BlockReader {
+public:
+    BlockReader(const uint8_t* data, const uint8_t* end) : p_(data), end_(end) {}
+
+    // Next entry, or false at the end of the block (or on corrupt data).
+    bool next(std::string& path, uint64_t& package) {
+        if (p_ == end_) return false;
+        uint64_t shared = 0;
+        uint64_t length = 0;
+        if (!first_ && !get_varint(p_, end_, shared)) return false;
+        if (!get_varint(p_, end_, length) || shared > path.size() || length > uint64_t(end_ - p_)) return false;
+        path.resize(shared);
+        path.append(reinterpret_cast<const char*>(p_), length);
+        p_ += length;
+        first_ = false;
+        return get_varint(p_, end_, package);
+    }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool first_ = true;
+};
+
+} // namespace
+
+std::string_view normalize_contents_path(std::string_view path) {
+    while (true) {
+        if (!path.empty() && path.front() == '/') {
+            path.remove_prefix(1);
+        } else if (path.size() >= 2 && path[0] == '.' && path[1] == '/') {
+            path.remove_prefix(2);
+        } else {
+            return path;
+        }
+    }
+}
+
+std::string build_contents_index(const std::vector<PackageFiles>& packages) {
+    std::vector<Entry> entries;
+    std::vector<uint32_t> name_offsets;
+    std::string names;
+    for (uint32_t id = 0; id < packages.size(); ++id) {
+        name_offsets.push_back(static_cast<uint32_t>(names.size()));
+        names.append(packages[id].name);
+        for (const std::string& file : packages[id].files) {
+            std::string_view path = normalize_contents_path(file);
+            if (!path.empty()) entries.push_back({path, id});
+        }
+    }
+    name_offsets.push_back(static_cast<uint32_t>(names.size()));
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.path != b.path ? a.path < b.path : a.package < b.package;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.path == b.path && a.package == b.package;
+    }), entries.end());
+
+    std::vector<uint64_t> directory;
+    std::string blocks;
+    std::string_view previous;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const Entry& e = entries[i];
+        if (i % CONTENTS_BLOCK_ENTRIES == 0) {
+            directory.push_back(blocks.size());
+            put_varint(blocks, e.path.size());
+        } else {
+            std::size_t shared = 0;
+            std::size_t limit = std::min(previous.size(), e.path.size());
+            while (shared < limit && previous[shared] == e.path[shared]) ++shared;
+            put_varint(blocks, shared);
+            put_varint(blocks, e.path.size() - shared);
+            blocks.append(e.path.substr(shared));
+            put_varint(blocks, e.package);
+            previous = e.path;
+            continue;
+        }
+        blocks.append(e.path);
+        put_varint(blocks, e.package);
+        previous = e.path;
+    }
+    directory.push_back(blocks.size());
+
+    ContentsHeader header{};
+    std::memcpy(header.magic, REPO_CONTENTS_MAGIC, sizeof(header.magic));
+    header.version = REPO_CONTENTS_VERSION;
+    header.package_count = static_cast<uint32_t>(packages.size());
+    header.entry_count = entries.size();
+    header.block_count = static_cast<uint32_t>(directory.size() - 1);
+    header.names_offset = sizeof(ContentsHeader);
+    uint64_t names_end = header.names_offset + name_offsets.size() * sizeof(uint32_t) + names.size();
+    header.directory_offset = (names_end + 7) / 8 * 8;
+    header.blocks_offset = header.directory_offset + directory.size() * sizeof(uint64_t);
+    header.blocks_size = blocks.size();
+
+    std::string bytes;
+    bytes.reserve(header.blocks_offset + blocks.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(name_offsets.data()), name_offsets.size() * sizeof(uint32_t));
+    bytes.append(names);
+    bytes.resize(header.directory_offset, '\0');
+    bytes.append(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(uint64_t));
+    bytes.append(blocks);
+    return bytes;
+}
+
+bool ContentsIndex::open(const std::string& path) {
+    close();
+    if (!file_.open(path) || file_.size() < sizeof(ContentsHeader)) return false;
+    const auto* header = reinterpret_cast<const ContentsHeader*>(file_.data());
+    const uint64_t size = file_.size();
+    uint64_t names_table = header->names_offset + (uint64_t(header->package_count) + 1) * sizeof(uint32_t);
+    if (std::memcmp(header->magic, REPO_CONTENTS_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_CONTENTS_VERSION || names_table > header->directory_offset ||
+        header->directory_offset % 8 != 0 ||
+        header->directory_offset + (uint64_t(header->block_count) + 1) * sizeof(uint64_t) > header->blocks_offset ||
+        header->blocks_offset + header->blocks_size > size) {
+        file_.close();
+        return false;
+    }
+    name_offsets_ = reinterpret_cast<const uint32_t*>(file_.data() + header->names_offset);
+    names_ = file_.data() + names_table;
+    names_size_ = header->directory_offset - names_table;
+    directory_ = reinterpret_cast<const uint64_t*>(file_.data() + header->directory_offset);
+    blocks_ = reinterpret_cast<const uint8_t*>(file_.data() + header->blocks_offset);
+    for (uint32_t b = 0; b < header->block_count; ++b) {
+        if (directory_[b] >= directory_[b + 1]) {
+            file_.close();
+            return false;
+        }
+    }
+    if (directory_[header->block_count] != header->blocks_size) {
+        file_.close();
+        return false;
+    }
+    header_ = header;
+    return true;
+}
+
+void ContentsIndex::close() {
+    file_.close();
+    header_ = nullptr;
+}
+
+std::string_view ContentsIndex::package_name(uint32_t id) const {
+    if (!header_ || id >= header_->package_count) return {};
+    uint32_t begin = name_offsets_[id];
+    uint32_t end = name_offsets_[id + 1];
+    if (begin > end || end > names_size_) return {};
+    return std::string_view(names_ + begin, end - begin);
+}
+
+// The first entry of a block is stored whole, so its path can be compared
+// in place without decoding anything else.
+std::string_view ContentsIndex::first_path(uint32_t block) const {
+    const uint8_t* p = blocks_ + directory_[block];
+    const uint8_t* end = blocks_ + directory_[block + 1];
+    uint64_t length = 0;
+    if (!get_varint(p, end, length) || length > uint64_t(end - p)) return {};
+    return std::string_view(reinterpret_cast<const char*>(p), length);
+}
+
+bool ContentsIndex::find(std::string_view path, std::vector<uint32_t>& packages) const {
+    packages.clear();
+    if (!header_ || header_->block_count == 0) return header_ != nullptr;
+    path = normalize_contents_path(path);
+    // Entries for path may start at the end of the last block whose first
+    // path sorts before it.
+    uint32_t lo = 0;
+    uint32_t hi = header_->block_count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (first_path(mid) < path) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    std::string current;
+    for (uint32_t block = lo; block < header_->block_count; ++block) {
+        BlockReader reader(blocks_ + directory_[block], blocks_ + directory_[block + 1]);
+        current.clear();
+        uint64_t package = 0;
+        std::size_t decoded = 0;
+        while (reader.next(current, package)) {
+            ++decoded;
+            if (package >= header_->package_count) return false;
+            int order = std::string_view(current).compare(path);
+            if (order > 0) return true;
+            if (order == 0) packages.push_back(static_cast<uint32_t>(package));
+        }
+        if (decoded == 0) return false;
+    }
+    return true;
+}
+
+bool ContentsIndex::for_each(const std::function<bool(std::string_view, uint32_t)>& f) const {
+    if (!header_) return false;
+    std::string current;
+    uint64_t seen = 0;
+    for (uint32_t block = 0; block < header_->block_count; ++block) {
+        BlockReader reader(blocks_ + directory_[block], blocks_ + directory_[block + 1]);
+        current.clear();
+        uint64_t package = 0;
+        while (reader.next(current, package)) {
+            if (package >= header_->package_count) return false;
+            ++seen;
+            if (!f(current, static_cast<uint32_t>(package))) return true;
+        }
+    }
+    return seen == header_->entry_count;
+}
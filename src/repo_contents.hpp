@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// Repository-wide file contents index (`fox provides`).
+//
+// `fox repo-index` collects the "files" list of every package into
+// contents.idx next to repo.json, and `fox update` fetches it along with
+// repo.json. Unlike the local binary index this file is shipped between
+// machines, so it has its own version and every fixed-width integer is
+// little-endian; everything else is LEB128 varints.
+//
+//   ContentsHeader
+//   uint32_t[package_count + 1]  offset of each package name in the blob
+//   char[...]                    package names, sorted
+//   uint64_t[block_count + 1]    offset of each block within the blocks
+//   blocks                       (path, package id) entries sorted by path,
+//                                CONTENTS_BLOCK_ENTRIES per block
+//
+// Paths are stored without a leading '/' and front-coded: the first entry of
+// a block holds its whole path, every later one only the length of the
+// prefix it shares with the previous path and the remaining bytes. A lookup
+// binary-searches the block directory on the blocks' first paths and then
+// decodes a single block.
+
+constexpr char REPO_CONTENTS_MAGIC[8] = {'F', 'O', 'X', 'C', 'O', 'N', 'T', '\0'};
+constexpr uint32_t REPO_CONTENTS_VERSION = 1;
+constexpr uint32_t CONTENTS_BLOCK_ENTRIES = 64;
+
+struct ContentsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    uint64_t entry_count;
+    uint32_t block_count;
+    uint32_t reserved;
+    uint64_t names_offset;      // the name offset table; the blob follows it
+    uint64_t directory_offset;
+    uint64_t blocks_offset;
+    uint64_t blocks_size;
+};
+
+struct PackageFiles {
+    std::string_view name;
+    std::vector<std::string> files;
+};
+
+// Path as stored in the index: without leading "/" or "./".
+std::string_view normalize_contents_path(std::string_view path);
+
+// Serialize the contents index. packages must be sorted by name.
+std::string build_contents_index(const std::vector<PackageFiles>& packages);
+
+class ContentsIndex {
+public:
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return header_ != nullptr; }
+
+    uint64_t size() const { return header_ ? header_->entry_count : 0; }
+    uint32_t package_count() const { return header_ ? header_->package_count : 0; }
+    std::string_view package_name(uint32_t id) const;
+
+    // Ids of the packages shipping path, in name order. Returns false if the
+    // file turns out to be corrupt.
+    bool find(std::string_view path, std::vector<uint32_t>& packages) const;
+
+    // Call f(path, package id) for every entry in path order, until f
+    // returns false. Returns false if the file turns out to be corrupt.
+    bool for_each(const std::function<bool(std::string_view, uint32_t)>& f) const;
+
+private:
+    std::string_view first_path(uint32_t block) const;
+
+    MappedFile file_;
+    const ContentsHeader* header_ = nullptr;
+    const uint32_t* name_offsets_ = nullptr;
+    const char* names_ = nullptr;
+    uint64_t names_size_ = 0;
+    const uint64_t* directory_ = nullptr;
+    const uint8_t* blocks_ = nullptr;
+};
@@ -0,0 +1,211 @@
+#include "repo_delta.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unistd.h>
+
+#include "repo_update.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+bool write_text_atomically(const std::string& path, const std::string& text) {
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << text;
+        if (!out) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Regenerate a compressed variant of repo.json if the repository has one, so
+// it never lags behind the plain file.
+bool refresh_compressed(const std::string& repo_json, const char* suffix, const char* tool) {
+    std::string target = repo_json + suffix;
+    if (!std::filesystem::exists(target)) return true;
+    std::string tmp = target + ".tmp." + std::to_string(getpid());
+    std::string cmd = std::string(tool) + " " + shell_quote(repo_json) + " > " + shell_quote(tmp);
+    if (std::system(cmd.c_str()) != 0 || std::rename(tmp.c_str(), target.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool write_repo_json(const std::string& path, uint64_t generation,
+                     const std::vector<std::pair<std::string_view, std::string_view>>& extra_members,
+                     const std::vector<std::pair<std::string_view, std::string_view>>& packages) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out << "{\n  \"generation\": " << generation << ",\n";
+    for (const auto& [key, value] : extra_members) {
+        out << "  " << json(std::string(key)).dump() << ": " << value << ",\n";
+    }
+    out << "  \"packages\": {";
+    bool first = true;
+    for (const auto& [name, record] : packages) {
+        out << (first ? "\n    " : ",\n    ") << json(std::string(name)).dump() << ": " << record;
+        first = false;
+    }
+    out << (first ? "}\n}\n" : "\n  }\n}\n");
+    return static_cast<bool>(out);
+}
+
+bool apply_repo_deltas(const RepoRecords& base, const std::vector<json>& deltas,
+                       const std::string& out_path, std::string& error) {
+    uint64_t generation = base.generation;
+    // Later deltas win: a package changed twice keeps its newest record, and a
+    // package removed and re-added comes back.
+    std::map<std::string, std::string, std::less<>> changed;
+    std::set<std::string, std::less<>> removed;
+    for (const json& delta : deltas) {
+        if (!delta.is_object() || delta.value("from", uint64_t(0)) != generation ||
+            delta.value("generation", uint64_t(0)) != generation + 1) {
+            error = "delta chain broken after generation " + std::to_string(generation);
+            return false;
+        }
+        generation += 1;
+        auto rm = delta.find("removed");
+        if (rm != delta.end() && rm->is_array()) {
+            for (const auto& name : *rm) {
+                if (!name.is_string()) continue;
+                changed.erase(name.get<std::string>());
+                removed.insert(name.get<std::string>());
+            }
+        }
+        auto pkgs = delta.find("packages");
+        if (pkgs != delta.end() && pkgs->is_object()) {
+            for (auto it = pkgs->begin(); it != pkgs->end(); ++it) {
+                removed.erase(it.key());
+                changed[it.key()] = it.value().dump();
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string_view, std::string_view>> packages;
+    packages.reserve(base.packages.size() + changed.size());
+    std::set<std::string_view> replaced;
+    for (const RepoRecord& rec : base.packages) {
+        if (removed.count(rec.name)) continue;
+        auto it = changed.find(rec.name);
+        if (it != changed.end()) {
+            packages.emplace_back(rec.name, it->second);
+            replaced.insert(it->first);
+        } else {
+            packages.emplace_back(rec.name, rec.json);
+        }
+    }
+    for (const auto& [name, record] : changed) {
+        if (!replaced.count(name)) packages.emplace_back(name, record);
+    }
+
+    if (!write_repo_json(out_path, generation, base.extra_members, packages)) {
+        error = "cannot write " + out_path;
+        return false;
+    }
+    return true;
+}
+
+bool publish_repo_generation(const std::string& new_repo_path, const std::string& repo_dir,
+                             uint64_t& generation, std::string& error) {
+    const std::string repo_json = repo_dir + "/repo.json";
+    const std::string manifest_path = repo_dir + "/generation.json";
+    const std::string delta_dir = repo_dir + "/deltas";
+
+    RepoRecords next;
+    if (!load_repo_records(new_repo_path, next, &error)) return false;
+
+    RepoRecords current;
+    bool have_current = std::filesystem::exists(repo_json);
+    if (have_current && !load_repo_records(repo_json, current, &error)) return false;
+
+    uint64_t oldest = 0;
+    if (have_current) {
+        std::ifstream manifest_file(manifest_path);
+        json manifest = json::parse(manifest_file, nullptr, false);
+        oldest = manifest.is_object() ? manifest.value("oldest", current.generation) : current.generation;
+    }
+
+    json delta = {{"from", current.generation}, {"generation", current.generation + 1},
+                  {"packages", json::object()}, {"removed", json::array()}};
+    if (have_current) {
+        // Compare parsed records so formatting differences don't count.
+        std::unordered_map<std::string_view, std::string_view> previous;
+        for (const RepoRecord& rec : current.packages) previous[rec.name] = rec.json;
+        for (const RepoRecord& rec : next.packages) {
+            auto it = previous.find(rec.name);
+            json record = json::parse(rec.json, nullptr, false);
+            if (record.is_discarded()) {
+                error = "invalid record for package " + std::string(rec.name);
+                return false;
+            }
+            if (it == previous.end() || json::parse(it->second, nullptr, false) != record) {
+                delta["packages"][std::string(rec.name)] = std::move(record);
+            }
+            if (it != previous.end()) previous.erase(it);
+        }
+        std::vector<std::string> gone;
+        for (const auto& [name, raw] : previous) gone.emplace_back(name);
+        std::sort(gone.begin(), gone.end());
+        delta["removed"] = gone;
+        if (delta["packages"].empty() && gone.empty()) {
+            generation = current.generation;
+            return true;
+        }
+    }
+
+    generation = current.generation + 1;
+    if (have_current) {
+        std::filesystem::create_directories(delta_dir);
+        if (!write_text_atomically(delta_dir + "/" + std::to_string(generation) + ".json", delta.dump())) {
+            error = "cannot write delta for generation " + std::to_string(generation);
+            return false;
+        }
+    } else {
+        oldest = generation;
+    }
+
+    std::vector<std::pair<std::string_view, std::string_view>> packages;
+    packages.reserve(next.packages.size());
+    for (const RepoRecord& rec : next.packages) packages.emplace_back(rec.name, rec.json);
+    std::string staged = repo_json + ".tmp." + std::to_string(getpid());
+    if (!write_repo_json(staged, generation, next.extra_members, packages) ||
+        std::rename(staged.c_str(), repo_json.c_str()) != 0) {
+        std::remove(staged.c_str());
+        error = "cannot write " + repo_json;
+        return false;
+    }
+    if (!refresh_compressed(repo_json, ".zst", "zstd -qc") || !refresh_compressed(repo_json, ".xz", "xz -c")) {
+        error = "cannot refresh compressed copies of " + repo_json;
+        return false;
+    }
+
+    // Drop deltas that fall out of the history window.
+    if (generation > DELTA_HISTORY && oldest < generation - DELTA_HISTORY) {
+        for (uint64_t g = oldest + 1; g <= generation - DELTA_HISTORY; ++g) {
+            std::error_code ec;
+            std::filesystem::remove(delta_dir + "/" + std::to_string(g) + ".json", ec);
+        }
+        oldest = generation - DELTA_HISTORY;
+    }
+
+    // The manifest goes last so it never points at files that don't exist yet.
+    json manifest = {{"generation", generation}, {"oldest", oldest}};
+    if (!write_text_atomically(manifest_path, manifest.dump() + "\n")) {
+        error = "cannot write " + manifest_path;
+        return false;
+    }
+    return true;
+}
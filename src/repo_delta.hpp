@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "repo_scan.hpp"
+
+// Incremental repository updates.
+//
+// A repository that publishes generations keeps, next to repo.json:
+//
+//   generation.json   {"generation": N, "oldest": M}
+//   deltas/<G>.json   {"from": G-1, "generation": G,
+//                      "packages": {<added or changed package records>},
+//                      "removed": [<package names>]}
+//
+// with a delta for every G in (M, N], and repo.json itself carrying
+// "generation": N. A client at generation L with M <= L < N can reach N by
+// applying deltas L+1..N instead of downloading repo.json again.
+
+// Beyond this many deltas a full fetch is usually cheaper.
+constexpr uint64_t MAX_DELTA_CHAIN = 64;
+// How many deltas the publisher keeps around.
+constexpr uint64_t DELTA_HISTORY = 128;
+
+// Write a repo.json with the given generation, extra top-level members and
+// packages (name, raw JSON text of the record) in order.
+bool write_repo_json(const std::string& path, uint64_t generation,
+                     const std::vector<std::pair<std::string_view, std::string_view>>& extra_members,
+                     const std::vector<std::pair<std::string_view, std::string_view>>& packages);
+
+// Apply deltas (consecutive, starting at base.generation) to base and write
+// the resulting repo.json to out_path. Unchanged package records are copied
+// through byte for byte.
+bool apply_repo_deltas(const RepoRecords& base, const std::vector<nlohmann::json>& deltas,
+                       const std::string& out_path, std::string& error);
+
+// Repository side: make new_repo_path the next generation of the repository
+// in repo_dir. Writes deltas/<G>.json against the current repo.json, the new
+// repo.json (and refreshes repo.json.zst / repo.json.xz if present), prunes
+// old deltas and finally rewrites generation.json. Sets generation to the
+// published generation; if nothing changed, no new generation is created and
+// generation is the current one.
+bool publish_repo_generation(const std::string& new_repo_path, const std::string& repo_dir,
+                             uint64_t& generation, std::string& error);
@@ -0,0 +1,174 @@
+#include "repo_fuzzy.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <memory>
+
+#include "mapped_file.hpp"
+
+namespace {
+
+unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+uint32_t bigram(unsigned char a, unsigned char b) {
+    return uint32_t(fold(a)) << 8 | fold(b);
+}
+
+// Levenshtein distance to a fixed pattern of up to 64 characters, one
+// 64-bit word of vertical deltas per text character (Hyyrö's formulation of
+// Myers' bit-parallel algorithm).
+class BitParallelMatcher {
+public:
+    explicit BitParallelMatcher(std::string_view pattern) : length_(static_cast<uint32_t>(pattern.size())) {
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            unsigned char c = fold(static_cast<unsigned char>(pattern[i]));
+            peq_[c] |= uint64_t(1) << i;
+            if (c >= 'a' && c <= 'z') peq_[c - 'a' + 'A'] |= uint64_t(1) << i;
+        }
+    }
+
+    // Distance from the pattern to text, or limit + 1 once it is certain to
+    // exceed limit.
+    uint32_t distance(std::string_view text, uint32_t limit) const {
+        if (length_ == 0) return static_cast<uint32_t>(text.size());
+        const uint64_t high = uint64_t(1) << (length_ - 1);
+        uint64_t pv = ~uint64_t(0);
+        uint64_t mv = 0;
+        uint32_t score = length_;
+        for (std::size_t j = 0; j < text.size(); ++j) {
+            uint64_t eq = peq_[static_cast<unsigned char>(text[j])];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & high) {
+                ++score;
+            } else if (mh & high) {
+                --score;
+            }
+            // Row 0 of the DP matrix grows by one per text character.
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            // Each remaining character can lower the score by at most one.
+            std::size_t remaining = text.size() - j - 1;
+            if (score > limit + remaining) return limit + 1;
+        }
+        return score;
+    }
+
+private:
+    uint64_t peq_[256] = {};
+    uint32_t length_;
+};
+
+// Plain two-row DP for patterns longer than one machine word.
+uint32_t dp_distance(std::string_view a, std::string_view b) {
+    std::vector<uint32_t> row(b.size() + 1);
+    for (uint32_t j = 0; j <= b.size(); ++j) row[j] = j;
+    for (std::size_t i = 1; i <= a.size(); ++i) {
+        uint32_t diagonal = row[0];
+        row[0] = static_cast<uint32_t>(i);
+        for (std::size_t j = 1; j <= b.size(); ++j) {
+            uint32_t up = row[j];
+            uint32_t cost = fold(static_cast<unsigned char>(a[i - 1])) == fold(static_cast<unsigned char>(b[j - 1])) ? 0 : 1;
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + cost});
+            diagonal = up;
+        }
+    }
+    return row[b.size()];
+}
+
+} // namespace
+
+std::string build_name_table(const std::vector<std::string_view>& names) {
+    std::vector<uint32_t> offsets;
+    offsets.reserve(names.size() + 1);
+    std::string blob;
+    for (std::string_view name : names) {
+        offsets.push_back(static_cast<uint32_t>(blob.size()));
+        blob.append(name);
+    }
+    offsets.push_back(static_cast<uint32_t>(blob.size()));
+
+    NameTableHeader header{};
+    std::memcpy(header.magic, REPO_NAMES_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.package_count = static_cast<uint32_t>(names.size());
+    header.offsets_offset = sizeof(NameTableHeader);
+    header.blob_offset = header.offsets_offset + offsets.size() * sizeof(uint32_t);
+    header.blob_size = blob.size();
+
+    std::string bytes;
+    bytes.reserve(header.blob_offset + blob.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    bytes.append(blob);
+    return bytes;
+}
+
+uint32_t default_fuzzy_distance(std::string_view query) {
+    if (query.size() <= 4) return 1;
+    if (query.size() <= 8) return 2;
+    return 3;
+}
+
+bool fuzzy_search(const RepoIndex& index, std::string_view query, std::size_t limit, uint32_t max_distance,
+                  std::vector<FuzzyHit>& hits) {
+    hits.clear();
+    MappedFile file;
+    if (!file.open(index.names_path()) || file.size() < sizeof(NameTableHeader)) return false;
+    const auto* header = reinterpret_cast<const NameTableHeader*>(file.data());
+    if (std::memcmp(header->magic, REPO_NAMES_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_INDEX_VERSION || header->package_count != index.size() ||
+        header->offsets_offset + (uint64_t(header->package_count) + 1) * sizeof(uint32_t) > header->blob_offset ||
+        header->blob_offset + header->blob_size > file.size()) {
+        return false;
+    }
+    const auto* offsets = reinterpret_cast<const uint32_t*>(file.data() + header->offsets_offset);
+    const char* blob = file.data() + header->blob_offset;
+    if (offsets[header->package_count] > header->blob_size) return false;
+
+    auto query_bigrams = std::make_unique<std::bitset<65536>>();
+    for (std::size_t i = 0; i + 1 < query.size(); ++i) {
+        query_bigrams->set(bigram(static_cast<unsigned char>(query[i]), static_cast<unsigned char>(query[i + 1])));
+    }
+    BitParallelMatcher matcher(query.size() <= 64 ? query : std::string_view());
+
+    for (uint32_t id = 0; id < header->package_count; ++id) {
+        uint32_t begin = offsets[id];
+        uint32_t end = offsets[id + 1];
+        if (end < begin || end > header->blob_size) return false;
+        std::string_view name(blob + begin, end - begin);
+
+        uint32_t length_gap = static_cast<uint32_t>(name.size() > query.size() ? name.size() - query.size()
+                                                                              : query.size() - name.size());
+        if (length_gap > max_distance) continue;
+        // q-gram lemma: within k edits, at least |name| - 1 - 2k of the
+        // name's bigrams also occur in the query.
+        long needed = static_cast<long>(name.size()) - 1 - 2 * static_cast<long>(max_distance);
+        if (needed > 0) {
+            long shared = 0;
+            for (std::size_t i = 0; i + 1 < name.size(); ++i) {
+                shared += query_bigrams->test(bigram(static_cast<unsigned char>(name[i]),
+                                                     static_cast<unsigned char>(name[i + 1])));
+            }
+            if (shared < needed) continue;
+        }
+
+        uint32_t distance = query.size() <= 64 ? matcher.distance(name, max_distance) : dp_distance(query, name);
+        if (distance <= max_distance) hits.push_back({id, distance});
+    }
+
+    auto closer = [](const FuzzyHit& a, const FuzzyHit& b) {
+        return a.distance != b.distance ? a.distance < b.distance : a.package < b.package;
+    };
+    std::size_t keep = std::min(limit, hits.size());
+    std::partial_sort(hits.begin(), hits.begin() + keep, hits.end(), closer);
+    hits.resize(keep);
+    return true;
+}
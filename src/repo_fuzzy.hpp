@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "repo_index.hpp"
+
+// Typo-tolerant name lookup.
+//
+// Package names are packed into one blob with an offset table so a query can
+// sweep all of them without touching the index shards:
+//
+//   NameTableHeader
+//   uint32_t[package_count + 1]  offset of each name in the blob
+//   char[blob_size]              names in package id order
+//
+// Each name is first checked against cheap filters: its length, and the
+// number of its bigrams that also occur in the query (strings within edit
+// distance k share all but about 2k of their bigrams). Survivors get their
+// exact Levenshtein distance from a bit-parallel kernel (Myers' algorithm as
+// formulated by Hyyrö) that processes one name character per handful of
+// 64-bit operations. Matching is case-insensitive for ASCII.
+
+constexpr char REPO_NAMES_MAGIC[8] = {'F', 'O', 'X', 'N', 'A', 'M', 'E', '\0'};
+
+struct NameTableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    uint64_t offsets_offset;
+    uint64_t blob_offset;
+    uint64_t blob_size;
+};
+
+struct FuzzyHit {
+    uint32_t package;
+    uint32_t distance;
+};
+
+// Serialize the packed name table for packages 0..n-1.
+std::string build_name_table(const std::vector<std::string_view>& names);
+
+// Largest edit distance accepted for a query by default: 1 for short
+// queries, growing to 3 for long ones.
+uint32_t default_fuzzy_distance(std::string_view query);
+
+// Names within max_distance edits of query, closest first (ties in name
+// order), at most limit of them. Returns false if the name table cannot be
+// read.
+bool fuzzy_search(const RepoIndex& index, std::string_view query, std::size_t limit, uint32_t max_distance,
+                  std::vector<FuzzyHit>& hits);
@@ -0,0 +1,393 @@
+#include "repo_generate.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "content_hash.hpp"
+#include "mapped_file.hpp"
+#include "nlohmann/json.hpp"
+#include "repo_contents.hpp"
+#include "repo_delta.hpp"
+#include "repo_index.hpp"
+#include "repo_update.hpp"
+#include "repo_version.hpp"
+
+using ordered_json = nlohmann::ordered_json;
+
+namespace {
+
+constexpr const char* CACHE_NAME = ".fox-index-cache";
+constexpr const char* CACHE_MAGIC = "fox-index-cache";
+constexpr int CACHE_VERSION = 3;
+// An archive modified this close to the time the cache was written may have
+// changed again without its mtime ticking, so it is always rescanned.
+constexpr int64_t RACY_WINDOW_NS = 2'000'000'000;
+
+struct Archive {
+    std::string file;  // name within the directory
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    std::string name;    // package name from fox.json
+    std::string record;  // compact JSON record, without "url"
+    std::vector<std::string> files;  // paths the package installs
+    std::string problem;
+};
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t mtime_ns(const struct stat& st) {
+    return int64_t(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+}
+
+std::string hex64(uint64_t value) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016" PRIx64, value);
+    return buf;
+}
+
+bool read_command(const std::string& cmd, std::string& output) {
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return false;
+    char buf[4096];
+    std::size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) output.append(buf, n);
+    int status = pclose(pipe);
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Open one archive: hash it and turn its fox.json into a repo.json record.
+void scan_archive(const std::string& dir, Archive& archive) {
+    const std::string path = dir + "/" + archive.file;
+    MappedFile file;
+    if (!file.open(path)) {
+        archive.problem = "cannot read";
+        return;
+    }
+    // Describe exactly the bytes that were hashed.
+    archive.size = static_cast<uint64_t>(file.file_stat().st_size);
+    archive.mtime_ns = mtime_ns(file.file_stat());
+    uint64_t hash = content_hash64(file.view());
+    file.close();
+
+    std::string text;
+    if (!read_command("tar -xJOf " + shell_quote(path) + " fox.json 2>/dev/null", text) || text.empty()) {
+        text.clear();
+        if (!read_command("tar -xJOf " + shell_quote(path) + " ./fox.json 2>/dev/null", text) || text.empty()) {
+            archive.problem = "no fox.json in archive";
+            return;
+        }
+    }
+    ordered_json meta = ordered_json::parse(text, nullptr, false);
+    if (meta.is_discarded() || !meta.is_object()) {
+        archive.problem = "fox.json is not a JSON object";
+        return;
+    }
+    auto name = meta.find("name");
+    if (name == meta.end() || !name->is_string() || name->get<std::string>().empty()) {
+        archive.problem = "fox.json has no \"name\"";
+        return;
+    }
+
+    ordered_json record = ordered_json::object();
+    for (const char* key : {"name", "version", "description", "arch", "license"}) {
+        auto it = meta.find(key);
+        if (it != meta.end() && it->is_string()) record[key] = *it;
+    }
+    ordered_json deps = ordered_json::array();
+    auto it = meta.find("dependencies");
+    if (it != meta.end() && it->is_array()) {
+        for (const auto& dep : *it) {
+            if (dep.is_string()) deps.push_back(dep);
+        }
+    }
+    record["dependencies"] = deps;
+    it = meta.find("conflicts");
+    if (it != meta.end() && it->is_array()) {
+        ordered_json conflicts = ordered_json::array();
+        for (const auto& conflict : *it) {
+            if (conflict.is_string()) conflicts.push_back(conflict);
+        }
+        if (!conflicts.empty()) record["conflicts"] = conflicts;
+    }
+    it = meta.find("provides");
+    if (it != meta.end() && it->is_array()) {
+        ordered_json provides = ordered_json::array();
+        for (const auto& name : *it) {
+            if (name.is_string()) provides.push_back(name);
+        }
+        if (!provides.empty()) record["provides"] = provides;
+    }
+    it = meta.find("maintainer");
+    if (it != meta.end() && it->is_string()) record["maintainer"] = *it;
+    record["size"] = archive.size;
+    record["hash"] = "xxh64:" + hex64(hash);
+
+    // The file list goes to contents.idx rather than repo.json. Archives
+    // built without one are listed instead.
+    it = meta.find("files");
+    if (it != meta.end() && it->is_array()) {
+        for (const auto& file : *it) {
+            if (file.is_string()) archive.files.push_back(file.get<std::string>());
+        }
+    } else {
+        std::string listing;
+        if (read_command("tar -tJf " + shell_quote(path) + " 2>/dev/null", listing)) {
+            std::size_t begin = 0;
+            while (begin < listing.size()) {
+                std::size_t end = listing.find('\n', begin);
+                if (end == std::string::npos) end = listing.size();
+                std::string_view entry(listing.data() + begin, end - begin);
+                std::string_view path = normalize_contents_path(entry);
+                if (!path.empty() && path.back() != '/' && path != "fox.json") archive.files.emplace_back(path);
+                begin = end + 1;
+            }
+        }
+    }
+
+    archive.name = name->get<std::string>();
+    archive.record = record.dump();
+}
+
+// Cached archives by file name, and the key of the output they produced.
+struct Cache {
+    int64_t written_ns = 0;
+    std::string output_key;
+    std::unordered_map<std::string, Archive> archives;
+};
+
+void load_cache(const std::string& path, Cache& cache) {
+    std::ifstream in(path, std::ios::binary);
+    std::string line;
+    if (!std::getline(in, line)) return;
+    char magic[32] = {};
+    int version = 0;
+    long long written = 0;
+    char key[32] = {};
+    if (std::sscanf(line.c_str(), "%31s %d %lld %31s", magic, &version, &written, key) != 4 ||
+        std::string(magic) != CACHE_MAGIC || version != CACHE_VERSION) {
+        return;
+    }
+    cache.written_ns = written;
+    cache.output_key = key;
+    // file \t size \t mtime_ns \t name \t files (JSON array) \t record
+    while (std::getline(in, line)) {
+        std::size_t t1 = line.find('\t');
+        std::size_t t2 = t1 == std::string::npos ? t1 : line.find('\t', t1 + 1);
+        std::size_t t3 = t2 == std::string::npos ? t2 : line.find('\t', t2 + 1);
+        std::size_t t4 = t3 == std::string::npos ? t3 : line.find('\t', t3 + 1);
+        std::size_t t5 = t4 == std::string::npos ? t4 : line.find('\t', t4 + 1);
+        if (t5 == std::string::npos) continue;
+        ordered_json files = ordered_json::parse(line.substr(t4 + 1, t5 - t4 - 1), nullptr, false);
+        if (!files.is_array()) continue;
+        Archive archive;
+        archive.file = line.substr(0, t1);
+        archive.size = std::strtoull(line.c_str() + t1 + 1, nullptr, 10);
+        archive.mtime_ns = std::strtoll(line.c_str() + t2 + 1, nullptr, 10);
+        archive.name = line.substr(t3 + 1, t4 - t3 - 1);
+        for (const auto& file : files) {
+            if (file.is_string()) archive.files.push_back(file.get<std::string>());
+        }
+        archive.record = line.substr(t5 + 1);
+        cache.archives[archive.file] = std::move(archive);
+    }
+}
+
+bool save_cache(const std::string& path, const std::vector<Archive>& archives, const std::string& output_key) {
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << CACHE_MAGIC << ' ' << CACHE_VERSION << ' ' << now_ns() << ' ' << output_key << '\n';
+        for (const Archive& a : archives) {
+            if (!a.problem.empty()) continue;
+            out << a.file << '\t' << a.size << '\t' << a.mtime_ns << '\t' << a.name << '\t'
+                << ordered_json(a.files).dump() << '\t' << a.record << '\n';
+        }
+        if (!out) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// The version in an archive's record, or "" without one.
+std::string record_version(const Archive& archive) {
+    ordered_json record = ordered_json::parse(archive.record, nullptr, false);
+    if (!record.is_object()) return {};
+    auto it = record.find("version");
+    return it != record.end() && it->is_string() ? it->get<std::string>() : std::string();
+}
+
+// Append "url" to a compact record ending in '}'.
+std::string with_url(const std::string& record, const std::string& url) {
+    return record.substr(0, record.size() - 1) + ",\"url\":" + ordered_json(url).dump() + "}";
+}
+
+} // namespace
+
+bool generate_repo_index(const std::string& dir, const RepoGenerateOptions& options,
+                         RepoGenerateStats& stats, std::string& error) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec)) {
+        error = dir + " is not a directory";
+        return false;
+    }
+    const std::string output = options.output.empty() ? dir + "/repo.json" : options.output;
+    const std::string index_path = std::filesystem::path(output).replace_extension(".idx").string();
+    const std::string cache_path = dir + "/" + CACHE_NAME;
+    const std::string contents_path = (std::filesystem::path(output).parent_path() / "contents.idx").string();
+
+    std::vector<Archive> archives;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != ".fox" || !entry.is_regular_file(ec)) continue;
+        Archive archive;
+        archive.file = entry.path().filename().string();
+        if (archive.file.find_first_of("\t\n") != std::string::npos) {
+            stats.problems.push_back(archive.file + ": unsupported file name");
+            continue;
+        }
+        struct stat st;
+        if (::stat(entry.path().c_str(), &st) != 0) continue;
+        archive.size = static_cast<uint64_t>(st.st_size);
+        archive.mtime_ns = mtime_ns(st);
+        archives.push_back(std::move(archive));
+    }
+    if (ec) {
+        error = "cannot list " + dir + ": " + ec.message();
+        return false;
+    }
+    std::sort(archives.begin(), archives.end(), [](const Archive& a, const Archive& b) { return a.file < b.file; });
+
+    Cache cache;
+    load_cache(cache_path, cache);
+    std::vector<std::size_t> todo;
+    for (std::size_t i = 0; i < archives.size(); ++i) {
+        Archive& archive = archives[i];
+        auto it = cache.archives.find(archive.file);
+        bool racy = archive.mtime_ns >= cache.written_ns - RACY_WINDOW_NS;
+        if (it != cache.archives.end() && it->second.size == archive.size &&
+            it->second.mtime_ns == archive.mtime_ns && !racy) {
+            archive.name = std::move(it->second.name);
+            archive.record = std::move(it->second.record);
+            archive.files = std::move(it->second.files);
+            ++stats.reused;
+        } else {
+            todo.push_back(i);
+        }
+        if (it != cache.archives.end()) cache.archives.erase(it);
+    }
+    stats.removed = cache.archives.size();
+    stats.scanned = todo.size();
+
+    // Extracting fox.json means running xz, so archives are handled in
+    // parallel; each worker claims the next archive until none are left.
+    unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = static_cast<unsigned>(std::min<std::size_t>(jobs, todo.size()));
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < todo.size(); i = next++) scan_archive(dir, archives[todo[i]]);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned j = 1; j < jobs; ++j) pool.emplace_back(worker);
+    if (jobs > 0) worker();
+    for (std::thread& t : pool) t.join();
+
+    // Packages in name order. When two archives carry the same package, the
+    // highest version wins (the file name that sorts last breaks a tie) and
+    // the others are reported.
+    std::vector<const Archive*> order;
+    for (const Archive& a : archives) {
+        if (!a.problem.empty()) {
+            stats.problems.push_back(a.file + ": " + a.problem);
+        } else {
+            order.push_back(&a);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [](const Archive* a, const Archive* b) { return a->name < b->name; });
+    std::vector<const Archive*> chosen;
+    for (std::size_t i = 0; i < order.size();) {
+        std::size_t end = i + 1;
+        while (end < order.size() && order[end]->name == order[i]->name) ++end;
+        if (end - i == 1) {
+            chosen.push_back(order[i]);
+            i = end;
+            continue;
+        }
+        std::vector<std::string> versions;
+        std::size_t best = i;
+        for (std::size_t j = i; j < end; ++j) {
+            versions.push_back(record_version(*order[j]));
+            if (version_key(versions.back()) >= version_key(versions[best - i])) best = j;
+        }
+        for (std::size_t j = i; j < end; ++j) {
+            if (j == best) continue;
+            stats.problems.push_back(order[j]->file + ": " + order[j]->name + " " + versions[j - i] +
+                                     " is superseded by " + versions[best - i] + " in " + order[best]->file);
+        }
+        chosen.push_back(order[best]);
+        i = end;
+    }
+    std::vector<std::string> records;
+    std::vector<std::pair<std::string_view, std::string_view>> packages;
+    std::vector<PackageFiles> contents;
+    records.reserve(chosen.size());
+    uint64_t key = content_hash64(options.base_url);
+    for (const Archive* a : chosen) {
+        records.push_back(with_url(a->record, options.base_url + a->file));
+        key = content_hash64(a->name, key);
+        key = content_hash64(records.back(), key);
+    }
+    for (std::size_t i = 0; i < chosen.size(); ++i) {
+        packages.emplace_back(chosen[i]->name, records[i]);
+        contents.push_back({chosen[i]->name, chosen[i]->files});
+    }
+    stats.packages = packages.size();
+
+    // Leave repo.json alone when its contents would not change, so its mtime
+    // and ETag stay valid for clients.
+    const std::string output_key = hex64(key);
+    stats.changed = output_key != cache.output_key || !std::filesystem::exists(output) ||
+                    !std::filesystem::exists(index_path) || !std::filesystem::exists(contents_path);
+    if (stats.changed) {
+        std::string tmp = output + ".tmp." + std::to_string(getpid());
+        if (!write_repo_json(tmp, 0, {}, packages) || std::rename(tmp.c_str(), output.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            error = "cannot write " + output;
+            return false;
+        }
+        RepoRecords written;
+        if (!load_repo_records(output, written, &error) || !build_repo_index(written, index_path)) {
+            if (error.empty()) error = "cannot write " + index_path;
+            return false;
+        }
+        tmp = contents_path + ".tmp." + std::to_string(getpid());
+        std::string bytes = build_contents_index(contents);
+        bool written_ok = false;
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            written_ok = static_cast<bool>(out.write(bytes.data(), static_cast<std::streamsize>(bytes.size())));
+        }
+        if (!written_ok || std::rename(tmp.c_str(), contents_path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            error = "cannot write " + contents_path;
+            return false;
+        }
+    }
+    if (!save_cache(cache_path, archives, output_key)) {
+        error = "cannot write " + cache_path;
+        return false;
+    }
+    return true;
+}
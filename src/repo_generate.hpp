@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Repository-side index generation (`fox repo-index`).
+//
+// Every .fox archive in a directory is opened on a pool of worker threads:
+// its fox.json is extracted, and its size and XXH64 content hash are
+// recorded. The results are written as repo.json plus the binary index
+// (repo.idx) and the file contents index (contents.idx, see
+// repo_contents.hpp) next to it.
+//
+// A sidecar cache (.fox-index-cache in the same directory) remembers, per
+// archive, the size and mtime it had and the record produced from it. On the
+// next run archives whose size and mtime are unchanged are not opened at all,
+// so adding one package to a directory of thousands only reads that package.
+
+struct RepoGenerateOptions {
+    std::string output;    // repo.json to write; <dir>/repo.json when empty
+    std::string base_url;  // prefix for each package's "url"; the bare file name when empty
+    unsigned jobs = 0;     // worker threads; one per CPU when 0
+};
+
+struct RepoGenerateStats {
+    std::size_t packages = 0;  // records written
+    std::size_t scanned = 0;   // archives opened this run
+    std::size_t reused = 0;    // archives answered from the cache
+    std::size_t removed = 0;   // cached archives no longer present
+    bool changed = false;      // repo.json was (re)written
+    std::vector<std::string> problems;  // archives skipped, and why
+};
+
+// Generate the repository index for the .fox archives in dir.
+bool generate_repo_index(const std::string& dir, const RepoGenerateOptions& options,
+                         RepoGenerateStats& stats, std::string& error);
@@ -0,0 +1,150 @@
+#include "repo_graph.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Offsets and targets of one direction, from edges sorted by source.
+void compressed_rows(uint32_t package_count, const std::vector<std::pair<uint32_t, uint32_t>>& edges,
+                     std::vector<uint32_t>& offsets, std::vector<uint32_t>& targets) {
+    offsets.assign(package_count + 1, 0);
+    for (const auto& e : edges) ++offsets[e.first + 1];
+    for (uint32_t p = 0; p < package_count; ++p) offsets[p + 1] += offsets[p];
+    targets.resize(edges.size());
+    for (std::size_t i = 0; i < edges.size(); ++i) targets[i] = edges[i].second;
+}
+
+template <typename T>
+void append(std::string& out, const std::vector<T>& values) {
+    out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+} // namespace
+
+std::string build_dependency_graph(uint32_t package_count, std::vector<std::pair<uint32_t, uint32_t>> edges) {
+    edges.erase(std::remove_if(edges.begin(), edges.end(),
+                               [&](const auto& e) {
+                                   return e.first == e.second || e.first >= package_count || e.second >= package_count;
+                               }),
+                edges.end());
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    std::vector<uint32_t> forward_offsets, forward, reverse_offsets, reverse;
+    compressed_rows(package_count, edges, forward_offsets, forward);
+    for (auto& e : edges) std::swap(e.first, e.second);
+    std::sort(edges.begin(), edges.end());
+    compressed_rows(package_count, edges, reverse_offsets, reverse);
+
+    GraphHeader header{};
+    std::memcpy(header.magic, REPO_GRAPH_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.package_count = package_count;
+    header.edge_count = static_cast<uint32_t>(edges.size());
+    header.forward_offsets_offset = sizeof(GraphHeader);
+    header.forward_offset = header.forward_offsets_offset + forward_offsets.size() * sizeof(uint32_t);
+    header.reverse_offsets_offset = header.forward_offset + forward.size() * sizeof(uint32_t);
+    header.reverse_offset = header.reverse_offsets_offset + reverse_offsets.size() * sizeof(uint32_t);
+
+    std::string bytes;
+    bytes.reserve(header.reverse_offset + reverse.size() * sizeof(uint32_t));
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    append(bytes, forward_offsets);
+    append(bytes, forward);
+    append(bytes, reverse_offsets);
+    append(bytes, reverse);
+    return bytes;
+}
+
+bool PackageSet::empty() const {
+    return std::all_of(words_.begin(), words_.end(), [](uint64_t w) { return w == 0; });
+}
+
+uint32_t PackageSet::count() const {
+    uint32_t n = 0;
+    for (uint64_t w : words_) n += static_cast<uint32_t>(__builtin_popcountll(w));
+    return n;
+}
+
+std::vector<uint32_t> PackageSet::ids() const {
+    std::vector<uint32_t> out;
+    out.reserve(count());
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+        for (uint64_t w = words_[i]; w; w &= w - 1) out.push_back(static_cast<uint32_t>(i * 64 + __builtin_ctzll(w)));
+    }
+    return out;
+}
+
+bool DependencyGraph::open(const RepoIndex& index) {
+    header_ = nullptr;
+    MappedFile file;
+    if (!index.is_open() || !file.open(index.graph_path()) || file.size() < sizeof(GraphHeader)) return false;
+    const auto* header = reinterpret_cast<const GraphHeader*>(file.data());
+    const uint64_t rows = (uint64_t(header->package_count) + 1) * sizeof(uint32_t);
+    const uint64_t edges = uint64_t(header->edge_count) * sizeof(uint32_t);
+    if (std::memcmp(header->magic, REPO_GRAPH_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_INDEX_VERSION || header->package_count != index.size() ||
+        header->forward_offsets_offset < sizeof(GraphHeader) ||
+        header->forward_offsets_offset + rows > header->forward_offset ||
+        header->forward_offset + edges > header->reverse_offsets_offset ||
+        header->reverse_offsets_offset + rows > header->reverse_offset ||
+        header->reverse_offset + edges > file.size()) {
+        return false;
+    }
+    const char* bytes = file.data();
+    forward_offsets_ = reinterpret_cast<const uint32_t*>(bytes + header->forward_offsets_offset);
+    forward_ = reinterpret_cast<const uint32_t*>(bytes + header->forward_offset);
+    reverse_offsets_ = reinterpret_cast<const uint32_t*>(bytes + header->reverse_offsets_offset);
+    reverse_ = reinterpret_cast<const uint32_t*>(bytes + header->reverse_offset);
+    // Rows must be ascending and end at edge_count, so no range leaves the file.
+    for (const uint32_t* offsets : {forward_offsets_, reverse_offsets_}) {
+        if (offsets[0] != 0 || offsets[header->package_count] != header->edge_count) return false;
+        for (uint32_t p = 0; p < header->package_count; ++p) {
+            if (offsets[p] > offsets[p + 1]) return false;
+        }
+    }
+    for (const uint32_t* targets : {forward_, reverse_}) {
+        for (uint32_t e = 0; e < header->edge_count; ++e) {
+            if (targets[e] >= header->package_count) return false;
+        }
+    }
+    header_ = header;
+    file_ = std::move(file);
+    return true;
+}
+
+PackageSet DependencyGraph::closure(const std::vector<uint32_t>& roots, bool reverse) const {
+    const uint32_t n = size();
+    const uint32_t* offsets = reverse ? reverse_offsets_ : forward_offsets_;
+    const uint32_t* targets = reverse ? reverse_ : forward_;
+    PackageSet result(n);
+    PackageSet frontier(n);
+    PackageSet next(n);
+    for (uint32_t id : roots) {
+        if (id >= n || result.contains(id)) continue;
+        result.insert(id);
+        frontier.insert(id);
+    }
+    // Each sweep visits the frontier word by word; a level with no new
+    // package ends the walk.
+    bool grew = !frontier.empty();
+    while (grew) {
+        grew = false;
+        const std::vector<uint64_t>& words = frontier.words();
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            for (uint64_t w = words[i]; w; w &= w - 1) {
+                uint32_t id = static_cast<uint32_t>(i * 64 + __builtin_ctzll(w));
+                for (uint32_t e = offsets[id]; e < offsets[id + 1]; ++e) {
+                    uint32_t t = targets[e];
+                    if (result.contains(t)) continue;
+                    result.insert(t);
+                    next.insert(t);
+                    grew = true;
+                }
+            }
+        }
+        std::swap(frontier, next);
+        next.clear();
+    }
+    return result;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "repo_index.hpp"
+
+// Dependency graph.
+//
+// Following a dependency through the shards means mapping the shard and
+// reading its DepRecords, which is fine for one package but not for
+// questions about the whole repository ("what needs glibc?"). The graph file
+// holds just the edges between package ids as compressed sparse rows, in both
+// directions:
+//
+//   GraphHeader
+//   uint32_t forward_offsets[package_count + 1]
+//   uint32_t forward[edge_count]    what each package depends on, sorted
+//   uint32_t reverse_offsets[package_count + 1]
+//   uint32_t reverse[edge_count]    what depends on each package, sorted
+//
+// The edges of package p are forward[forward_offsets[p] .. forward_offsets[p + 1]).
+// Every alternative of every dependency the repository carries is an edge,
+// whatever its version constraint; conflicts and self-dependencies are not.
+//
+// Closures are computed a level at a time over bitsets of package ids: the
+// frontier is scanned a 64-bit word at a time, skipping empty words, and
+// each level's new packages are those of its edges not yet in the result.
+
+constexpr char REPO_GRAPH_MAGIC[8] = {'F', 'O', 'X', 'G', 'R', 'P', 'H', '\0'};
+
+struct GraphHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    uint32_t edge_count;
+    uint32_t reserved;
+    uint64_t forward_offsets_offset;
+    uint64_t forward_offset;
+    uint64_t reverse_offsets_offset;
+    uint64_t reverse_offset;
+};
+
+// Serialize the graph over package_count packages from (package, target)
+// edges in any order; duplicates are dropped.
+std::string build_dependency_graph(uint32_t package_count, std::vector<std::pair<uint32_t, uint32_t>> edges);
+
+// A set of package ids, one bit each.
+class PackageSet {
+public:
+    explicit PackageSet(uint32_t size = 0) : words_((size + 63) / 64, 0), size_(size) {}
+
+    uint32_t size() const { return size_; }
+    bool contains(uint32_t id) const { return words_[id >> 6] >> (id & 63) & 1; }
+    void insert(uint32_t id) { words_[id >> 6] |= uint64_t(1) << (id & 63); }
+    void clear() { std::fill(words_.begin(), words_.end(), 0); }
+    bool empty() const;
+    uint32_t count() const;
+    // Ids in the set, ascending.
+    std::vector<uint32_t> ids() const;
+
+    const std::vector<uint64_t>& words() const { return words_; }
+
+private:
+    std::vector<uint64_t> words_;
+    uint32_t size_;
+};
+
+// A run of package ids inside the mapping.
+struct IdRange {
+    const uint32_t* first = nullptr;
+    const uint32_t* last = nullptr;
+
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    std::size_t size() const { return last - first; }
+};
+
+class DependencyGraph {
+public:
+    // Map the graph file of index. Returns false if it is missing or does
+    // not match the index.
+    bool open(const RepoIndex& index);
+    bool is_open() const { return header_ != nullptr; }
+    uint32_t size() const { return header_ ? header_->package_count : 0; }
+
+    // What id depends on, and what depends on id.
+    IdRange dependencies(uint32_t id) const { return {forward_ + forward_offsets_[id], forward_ + forward_offsets_[id + 1]}; }
+    IdRange dependents(uint32_t id) const { return {reverse_ + reverse_offsets_[id], reverse_ + reverse_offsets_[id + 1]}; }
+
+    // Everything reachable from roots along dependencies (or, with reverse,
+    // everything that reaches them), roots included.
+    PackageSet closure(const std::vector<uint32_t>& roots, bool reverse) const;
+
+private:
+    MappedFile file_;
+    const GraphHeader* header_ = nullptr;
+    const uint32_t* forward_offsets_ = nullptr;
+    const uint32_t* forward_ = nullptr;
+    const uint32_t* reverse_offsets_ = nullptr;
+    const uint32_t* reverse_ = nullptr;
+};
@@ -0,0 +1,594 @@
+#include "repo_index.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "content_hash.hpp"
+#include "repo_complete.hpp"
+#include "repo_fuzzy.hpp"
+#include "repo_graph.hpp"
+#include "repo_query.hpp"
+#include "repo_search.hpp"
+#include "repo_trigram.hpp"
+#include "repo_version.hpp"
+
+namespace {
+
+// Package record during the build, with every string as an interned id.
+struct PendingRecord {
+    uint32_t name, version, description, arch, license, maintainer, url, repository, version_key;
+    uint32_t deps_begin;
+    uint32_t deps_count;
+};
+
+struct PendingDep {
+    uint32_t raw;
+    uint32_t name_length;
+    uint32_t package;
+    uint32_t version_key;
+    ConstraintOp op;
+    uint32_t flags;
+};
+
+// Timestamps this close to the build time may not have ticked yet on
+// coarse-grained filesystems, so they are not trusted on their own.
+constexpr int64_t RACY_WINDOW_NS = 2'000'000'000;
+
+// How long a shard dropped from the directory is kept for readers that
+// mapped the previous directory but have not opened that shard yet.
+constexpr int64_t SHARD_GRACE_NS = 3600'000'000'000;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t mtime_ns(const struct stat& st) {
+    return int64_t(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+}
+
+SourceStamp stat_stamp(const struct stat& st) {
+    return {static_cast<uint64_t>(st.st_ino), static_cast<uint64_t>(st.st_size), mtime_ns(st), 0};
+}
+
+template <typename T>
+void append(std::string& out, const T* data, std::size_t count) {
+    out.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+}
+
+// Lay out interned strings in id order.
+std::vector<StrRef> layout_strings(const StringInterner& strings, std::string& blob) {
+    std::vector<StrRef> refs(strings.size());
+    for (uint32_t id = 0; id < strings.size(); ++id) {
+        std::string_view str = strings.str(id);
+        refs[id] = {static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(str.size())};
+        blob.append(str);
+    }
+    return refs;
+}
+
+bool write_file_atomically(const std::string& path, const std::string& bytes) {
+    std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(bytes.data(), bytes.size());
+        if (!out) {
+            out.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Serialize packages [begin, end) of the sorted table as one shard file.
+// names holds every package name in the index and providers every (provided
+// name, provider id) pair, sorted, for resolving dependencies; the
+// dependencies found are added to edges as (package, target) ids.
+std::string serialize_shard(const RepoRecords& repo, const std::vector<const RepoRecord*>& packages,
+                            std::size_t begin, std::size_t end, const std::vector<std::string_view>& names,
+                            const std::vector<std::pair<std::string_view, uint32_t>>& providers,
+                            std::string_view repository, uint32_t& dependency_count,
+                            std::vector<std::pair<uint32_t, uint32_t>>& edges) {
+    StringInterner strings;
+    std::vector<PendingRecord> pending;
+    std::vector<PendingDep> pending_deps;
+    std::vector<std::string_view> alternatives;
+    pending.reserve(end - begin);
+    for (std::size_t i = begin; i < end; ++i) {
+        const RepoRecord& pkg = *packages[i];
+        PendingRecord rec;
+        rec.name = strings.intern(pkg.name);
+        rec.version = strings.intern(pkg.version);
+        rec.version_key = strings.intern(version_key(pkg.version));
+        rec.description = strings.intern(pkg.description);
+        rec.arch = strings.intern(pkg.arch);
+        rec.license = strings.intern(pkg.license);
+        rec.maintainer = strings.intern(pkg.maintainer);
+        rec.url = strings.intern(pkg.url);
+        rec.repository = strings.intern(pkg.repository.empty() ? repository : pkg.repository);
+        rec.deps_begin = static_cast<uint32_t>(pending_deps.size());
+        auto add = [&](std::string_view dep, uint32_t flags) {
+            Constraint constraint = parse_constraint(dep);
+            auto it = std::lower_bound(names.begin(), names.end(), constraint.name);
+            uint32_t target = it != names.end() && *it == constraint.name ? static_cast<uint32_t>(it - names.begin()) : REPO_INDEX_NPOS;
+            uint32_t key = strings.intern(constraint.op == ConstraintOp::Any ? std::string() : version_key(constraint.version));
+            pending_deps.push_back({strings.intern(dep), static_cast<uint32_t>(constraint.name.size()), target, key,
+                                    constraint.op, flags});
+            if (target != REPO_INDEX_NPOS && !(flags & DEP_CONFLICT)) edges.emplace_back(static_cast<uint32_t>(i), target);
+            // Provided names carry no version, so only an unversioned
+            // record can be met by a provider.
+            if (constraint.op != ConstraintOp::Any) return;
+            auto range = std::equal_range(providers.begin(), providers.end(), std::make_pair(constraint.name, uint32_t(0)),
+                                          [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (auto p = range.first; p != range.second; ++p) {
+                if (p->second == target) continue;
+                pending_deps.push_back({strings.intern(names[p->second]), static_cast<uint32_t>(names[p->second].size()),
+                                        p->second, strings.intern(std::string()), ConstraintOp::Any,
+                                        ((flags & DEP_CONFLICT) ? DEP_CONFLICT : DEP_ALTERNATIVE) | DEP_PROVIDER});
+                if (!(flags & DEP_CONFLICT)) edges.emplace_back(static_cast<uint32_t>(i), p->second);
+            }
+        };
+        for (uint32_t d = 0; d < pkg.deps_count; ++d) {
+            split_alternatives(repo.dependencies[pkg.deps_begin + d], alternatives);
+            for (std::size_t a = 0; a < alternatives.size(); ++a) add(alternatives[a], a ? DEP_ALTERNATIVE : 0);
+        }
+        for (uint32_t c = 0; c < pkg.conflicts_count; ++c) add(repo.conflicts[pkg.conflicts_begin + c], DEP_CONFLICT);
+        for (uint32_t p = 0; p < pkg.provides_count; ++p) {
+            std::string_view name = repo.provides[pkg.provides_begin + p];
+            pending_deps.push_back({strings.intern(name), static_cast<uint32_t>(name.size()), REPO_INDEX_NPOS,
+                                    strings.intern(std::string()), ConstraintOp::Any, DEP_PROVIDES});
+        }
+        rec.deps_count = static_cast<uint32_t>(pending_deps.size()) - rec.deps_begin;
+        pending.push_back(rec);
+    }
+    if (strings.total_bytes() > UINT32_MAX) return {};
+
+    std::string blob;
+    std::vector<StrRef> refs = layout_strings(strings, blob);
+    std::vector<IndexRecord> records;
+    records.reserve(pending.size());
+    for (const PendingRecord& p : pending) {
+        records.push_back({refs[p.name], refs[p.version], refs[p.description], refs[p.arch],
+                           refs[p.license], refs[p.maintainer], refs[p.url], refs[p.repository],
+                           refs[p.version_key], p.deps_begin, p.deps_count});
+    }
+    std::vector<DepRecord> deps;
+    deps.reserve(pending_deps.size());
+    for (const PendingDep& d : pending_deps) {
+        deps.push_back({refs[d.raw], d.name_length, d.package, refs[d.version_key], d.op, d.flags});
+    }
+
+    ShardHeader header{};
+    std::memcpy(header.magic, REPO_SHARD_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.package_count = static_cast<uint32_t>(records.size());
+    header.dependency_count = static_cast<uint32_t>(deps.size());
+    header.records_offset = sizeof(ShardHeader);
+    header.deps_offset = header.records_offset + records.size() * sizeof(IndexRecord);
+    header.strings_offset = header.deps_offset + deps.size() * sizeof(DepRecord);
+    header.strings_size = blob.size();
+    dependency_count = header.dependency_count;
+
+    std::string bytes;
+    bytes.reserve(header.strings_offset + blob.size());
+    append(bytes, &header, 1);
+    append(bytes, records.data(), records.size());
+    append(bytes, deps.data(), deps.size());
+    bytes.append(blob);
+    return bytes;
+}
+
+bool valid_directory(const MappedFile& file) {
+    if (file.size() < sizeof(IndexHeader)) return false;
+    const auto* header = reinterpret_cast<const IndexHeader*>(file.data());
+    return std::memcmp(header->magic, REPO_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == REPO_INDEX_VERSION &&
+           header->shards_offset + uint64_t(header->shard_count) * sizeof(ShardEntry) <= header->strings_offset &&
+           header->strings_offset + header->strings_size <= file.size();
+}
+
+// Shard files named by the directory at index_path, if there is a valid one.
+std::set<std::string> directory_shard_files(const std::string& index_path) {
+    std::set<std::string> files;
+    MappedFile file;
+    if (!file.open(index_path) || !valid_directory(file)) return files;
+    const auto* header = reinterpret_cast<const IndexHeader*>(file.data());
+    const auto* entries = reinterpret_cast<const ShardEntry*>(file.data() + header->shards_offset);
+    const char* strings = file.data() + header->strings_offset;
+    for (uint32_t s = 0; s < header->shard_count; ++s) {
+        if (uint64_t(entries[s].file.offset) + entries[s].file.length > header->strings_size) continue;
+        files.emplace(strings + entries[s].file.offset, entries[s].file.length);
+    }
+    return files;
+}
+
+// After a new directory is in place: restart the grace period of shards the
+// previous directory used, and delete unreferenced shards whose grace period
+// is over.
+void retire_shards(const std::string& shard_dir, const std::set<std::string>& current,
+                   const std::set<std::string>& previous) {
+    std::error_code ec;
+    const auto now = std::filesystem::file_time_type::clock::now();
+    const auto grace = std::chrono::nanoseconds(SHARD_GRACE_NS);
+    for (const auto& entry : std::filesystem::directory_iterator(shard_dir, ec)) {
+        std::string file = entry.path().filename().string();
+        if (current.count(file)) continue;
+        if (previous.count(file)) {
+            std::filesystem::last_write_time(entry.path(), now, ec);
+        } else if (std::filesystem::last_write_time(entry.path(), ec) < now - grace && !ec) {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+std::string hex64(uint64_t value) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016" PRIx64, value);
+    return buf;
+}
+
+} // namespace
+
+bool build_repo_index(const RepoRecords& repo, const std::string& index_path,
+                      std::string_view repository, const SourceStamp* source) {
+    // Sort by name; when repo.json repeats a package the last entry wins.
+    std::vector<uint32_t> order(repo.packages.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    auto by_name = [&repo](uint32_t a, uint32_t b) { return repo.packages[a].name < repo.packages[b].name; };
+    if (!std::is_sorted(order.begin(), order.end(), by_name)) {
+        std::stable_sort(order.begin(), order.end(), by_name);
+    }
+    std::vector<const RepoRecord*> packages;
+    std::vector<std::string_view> names;
+    packages.reserve(order.size());
+    names.reserve(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        if (i + 1 < order.size() && repo.packages[order[i + 1]].name == repo.packages[order[i]].name) continue;
+        packages.push_back(&repo.packages[order[i]]);
+        names.push_back(repo.packages[order[i]].name);
+    }
+    std::vector<std::pair<std::string_view, uint32_t>> providers;
+    for (uint32_t id = 0; id < packages.size(); ++id) {
+        for (uint32_t p = 0; p < packages[id]->provides_count; ++p) {
+            providers.emplace_back(repo.provides[packages[id]->provides_begin + p], id);
+        }
+    }
+    std::sort(providers.begin(), providers.end());
+    providers.erase(std::unique(providers.begin(), providers.end()), providers.end());
+
+    const std::string shard_dir = index_path + ".shards";
+    std::error_code ec;
+    std::filesystem::create_directories(shard_dir, ec);
+    if (ec) return false;
+
+    StringInterner dir_strings;
+    std::vector<std::pair<uint32_t, uint32_t>> shard_strings;  // first name, file
+    std::set<std::string> current;
+    uint64_t dependency_count = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;  // dependency graph, by package id
+    for (std::size_t begin = 0; begin < packages.size(); begin += REPO_INDEX_SHARD_PACKAGES) {
+        std::size_t end = std::min<std::size_t>(begin + REPO_INDEX_SHARD_PACKAGES, packages.size());
+        uint32_t shard_deps = 0;
+        std::string bytes = serialize_shard(repo, packages, begin, end, names, providers, repository, shard_deps, edges);
+        if (bytes.empty()) return false;
+        // Unchanged shards keep their file, and with it their page cache.
+        std::string file = hex64(content_hash64(bytes)) + ".shard";
+        std::string path = shard_dir + "/" + file;
+        if (!std::filesystem::exists(path, ec) && !write_file_atomically(path, bytes)) return false;
+        shard_strings.emplace_back(dir_strings.intern(names[begin]), dir_strings.intern(file));
+        current.insert(file);
+        dependency_count += shard_deps;
+    }
+
+    std::vector<std::string_view> descriptions;
+    descriptions.reserve(packages.size());
+    for (const RepoRecord* pkg : packages) descriptions.push_back(pkg->description);
+    // Search indexes are content-addressed files next to the shards.
+    auto store = [&](const std::string& bytes, const char* suffix, uint32_t& file_string) {
+        std::string file = hex64(content_hash64(bytes)) + suffix;
+        std::string path = shard_dir + "/" + file;
+        if (!std::filesystem::exists(path, ec) && !write_file_atomically(path, bytes)) return false;
+        file_string = dir_strings.intern(file);
+        current.insert(file);
+        return true;
+    };
+    uint32_t terms_string = 0;
+    uint32_t trigrams_string = 0;
+    uint32_t names_string = 0;
+    uint32_t text_string = 0;
+    uint32_t columns_string = 0;
+    uint32_t trie_string = 0;
+    uint32_t graph_string = 0;
+    if (!store(build_term_index(names, descriptions), ".terms", terms_string) ||
+        !store(build_trigram_index(names, descriptions), ".trigrams", trigrams_string) ||
+        !store(build_name_table(names), ".names", names_string) ||
+        !store(build_text_table(names, descriptions), ".text", text_string) ||
+        !store(build_column_index(repo, packages), ".columns", columns_string) ||
+        !store(build_name_trie(names), ".trie", trie_string) ||
+        !store(build_dependency_graph(static_cast<uint32_t>(packages.size()), std::move(edges)), ".graph", graph_string)) {
+        return false;
+    }
+
+    if (dependency_count > UINT32_MAX || dir_strings.total_bytes() > UINT32_MAX) return false;
+
+    std::string blob;
+    std::vector<StrRef> refs = layout_strings(dir_strings, blob);
+    std::vector<ShardEntry> entries;
+    for (std::size_t s = 0; s < shard_strings.size(); ++s) {
+        uint32_t first = static_cast<uint32_t>(s * REPO_INDEX_SHARD_PACKAGES);
+        uint32_t count = static_cast<uint32_t>(std::min<std::size_t>(REPO_INDEX_SHARD_PACKAGES, packages.size() - first));
+        entries.push_back({first, count, refs[shard_strings[s].first], refs[shard_strings[s].second]});
+    }
+
+    IndexHeader header{};
+    std::memcpy(header.magic, REPO_INDEX_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.package_count = static_cast<uint32_t>(packages.size());
+    header.dependency_count = static_cast<uint32_t>(dependency_count);
+    header.shard_count = static_cast<uint32_t>(entries.size());
+    header.shards_offset = sizeof(IndexHeader);
+    header.strings_offset = header.shards_offset + entries.size() * sizeof(ShardEntry);
+    header.strings_size = blob.size();
+    if (source) {
+        header.source = *source;
+    } else if (repo.file.is_open()) {
+        header.source = stat_stamp(repo.file.file_stat());
+        header.source.hash = content_hash64(repo.file.view());
+    }
+    header.built_at_ns = now_ns();
+    header.terms_file = refs[terms_string];
+    header.trigrams_file = refs[trigrams_string];
+    header.names_file = refs[names_string];
+    header.text_file = refs[text_string];
+    header.columns_file = refs[columns_string];
+    header.trie_file = refs[trie_string];
+    header.graph_file = refs[graph_string];
+    std::string bloom = build_bloom_filter(names);
+    header.bloom_offset = (header.strings_offset + blob.size() + 31) / 32 * 32;
+    header.bloom_blocks = static_cast<uint32_t>(bloom.size() / sizeof(BloomBlock));
+
+    std::string bytes;
+    append(bytes, &header, 1);
+    append(bytes, entries.data(), entries.size());
+    bytes.append(blob);
+    bytes.resize(header.bloom_offset, '\0');
+    bytes.append(bloom);
+    std::set<std::string> previous = directory_shard_files(index_path);
+    if (!write_file_atomically(index_path, bytes)) return false;
+    retire_shards(shard_dir, current, previous);
+    return true;
+}
+
+bool RepoIndex::open(const std::string& index_path) {
+    close();
+    MappedFile file;
+    if (!file.open(index_path) || !valid_directory(file)) return false;
+
+    const char* bytes = file.data();
+    const auto* header = reinterpret_cast<const IndexHeader*>(bytes);
+    const auto* shards = reinterpret_cast<const ShardEntry*>(bytes + header->shards_offset);
+    // Shards must tile [0, package_count) in order, all of them full except
+    // the last, so a package id maps straight to its shard.
+    uint32_t next = 0;
+    for (uint32_t s = 0; s < header->shard_count; ++s) {
+        const ShardEntry& e = shards[s];
+        bool full = e.package_count == REPO_INDEX_SHARD_PACKAGES;
+        if (e.first_package != next || e.package_count == 0 || e.package_count > REPO_INDEX_SHARD_PACKAGES ||
+            (s + 1 < header->shard_count && !full) ||
+            uint64_t(e.first_name.offset) + e.first_name.length > header->strings_size ||
+            uint64_t(e.file.offset) + e.file.length > header->strings_size) {
+            return false;
+        }
+        next += e.package_count;
+    }
+    if (next != header->package_count ||
+        uint64_t(header->terms_file.offset) + header->terms_file.length > header->strings_size ||
+        uint64_t(header->trigrams_file.offset) + header->trigrams_file.length > header->strings_size ||
+        uint64_t(header->names_file.offset) + header->names_file.length > header->strings_size ||
+        uint64_t(header->text_file.offset) + header->text_file.length > header->strings_size ||
+        uint64_t(header->columns_file.offset) + header->columns_file.length > header->strings_size ||
+        uint64_t(header->trie_file.offset) + header->trie_file.length > header->strings_size ||
+        uint64_t(header->graph_file.offset) + header->graph_file.length > header->strings_size ||
+        header->bloom_offset % 32 != 0 || header->bloom_offset < header->strings_offset + header->strings_size ||
+        header->bloom_offset + uint64_t(header->bloom_blocks) * sizeof(BloomBlock) > file.size()) {
+        return false;
+    }
+
+    header_ = header;
+    shards_ = shards;
+    strings_ = bytes + header->strings_offset;
+    bloom_ = reinterpret_cast<const BloomBlock*>(bytes + header->bloom_offset);
+    index_path_ = index_path;
+    shard_dir_ = index_path + ".shards";
+    loaded_.resize(header->shard_count);
+    file_ = std::move(file);
+    return true;
+}
+
+bool RepoIndex::open_if_current(const std::string& index_path, const std::string& source_path) {
+    struct stat st;
+    if (::stat(source_path.c_str(), &st) != 0 || !open(index_path)) {
+        close();
+        return false;
+    }
+    SourceStamp current = stat_stamp(st);
+    const SourceStamp& built = header_->source;
+    if (current.size != built.size) {
+        close();
+        return false;
+    }
+    bool racy = current.mtime_ns >= header_->built_at_ns - RACY_WINDOW_NS;
+    if (current.inode == built.inode && current.mtime_ns == built.mtime_ns && !racy) {
+        return true;
+    }
+
+    MappedFile source;
+    if (!source.open(source_path) || content_hash64(source.view()) != built.hash) {
+        close();
+        return false;
+    }
+    // Same bytes under a new inode or mtime: record the new identity.
+    current = stat_stamp(source.file_stat());
+    current.hash = built.hash;
+    int64_t built_at = now_ns();
+    int fd = ::open(index_path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        pwrite(fd, &current, sizeof(current), offsetof(IndexHeader, source));
+        pwrite(fd, &built_at, sizeof(built_at), offsetof(IndexHeader, built_at_ns));
+        ::close(fd);
+    }
+    return true;
+}
+
+bool RepoIndex::replaced() const {
+    struct stat st;
+    if (!header_ || ::stat(index_path_.c_str(), &st) != 0) return false;
+    return st.st_ino != file_.file_stat().st_ino || st.st_dev != file_.file_stat().st_dev;
+}
+
+void RepoIndex::close() {
+    file_.close();
+    header_ = nullptr;
+    shards_ = nullptr;
+    strings_ = nullptr;
+    bloom_ = nullptr;
+    index_path_.clear();
+    shard_dir_.clear();
+    loaded_.clear();
+}
+
+uint32_t RepoIndex::loaded_shard_count() const {
+    uint32_t count = 0;
+    for (const Shard& shard : loaded_) count += shard.records != nullptr;
+    return count;
+}
+
+const RepoIndex::Shard* RepoIndex::load_shard(uint32_t s) const {
+    Shard& shard = loaded_[s];
+    if (shard.records) return &shard;
+    MappedFile file;
+    if (!file.open(shard_dir_ + "/" + std::string(str(shards_[s].file))) || file.size() < sizeof(ShardHeader)) {
+        return nullptr;
+    }
+    const auto* header = reinterpret_cast<const ShardHeader*>(file.data());
+    bool valid = std::memcmp(header->magic, REPO_SHARD_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == REPO_INDEX_VERSION &&
+                 header->package_count == shards_[s].package_count &&
+                 header->records_offset >= sizeof(ShardHeader) && header->records_offset <= file.size() &&
+                 header->deps_offset <= file.size() &&
+                 header->records_offset % alignof(IndexRecord) == 0 &&
+                 header->deps_offset % alignof(DepRecord) == 0 &&
+                 header->records_offset + uint64_t(header->package_count) * sizeof(IndexRecord) <= header->deps_offset &&
+                 header->deps_offset + uint64_t(header->dependency_count) * sizeof(DepRecord) <= header->strings_offset &&
+                 header->strings_offset <= file.size() && header->strings_size <= file.size() - header->strings_offset;
+    if (!valid) return nullptr;
+    const auto* records = reinterpret_cast<const IndexRecord*>(file.data() + header->records_offset);
+    const auto* deps = reinterpret_cast<const DepRecord*>(file.data() + header->deps_offset);
+    // Every string and dependency range is checked once here, so lookups can
+    // slice the shard without bounds checks.
+    const uint64_t strings_size = header->strings_size;
+    auto fits = [strings_size](const StrRef& ref) { return uint64_t(ref.offset) + ref.length <= strings_size; };
+    for (uint32_t r = 0; r < header->package_count; ++r) {
+        const IndexRecord& rec = records[r];
+        for (const StrRef* ref : {&rec.name, &rec.version, &rec.description, &rec.arch, &rec.license,
+                                  &rec.maintainer, &rec.url, &rec.repository, &rec.version_key}) {
+            if (!fits(*ref)) return nullptr;
+        }
+        if (uint64_t(rec.deps_begin) + rec.deps_count > header->dependency_count) return nullptr;
+    }
+    for (uint32_t d = 0; d < header->dependency_count; ++d) {
+        const DepRecord& dep = deps[d];
+        if (!fits(dep.raw) || !fits(dep.version_key) || dep.name_length > dep.raw.length ||
+            (dep.package != REPO_INDEX_NPOS && dep.package >= size()) || dep.op > ConstraintOp::Invalid) {
+            return nullptr;
+        }
+    }
+    shard.records = records;
+    shard.deps = deps;
+    shard.strings = file.data() + header->strings_offset;
+    shard.file = std::move(file);
+    return &shard;
+}
+
+const RepoIndex::Shard* RepoIndex::shard_of(uint32_t id) const {
+    if (id >= size()) return nullptr;
+    return load_shard(id / REPO_INDEX_SHARD_PACKAGES);
+}
+
+bool RepoIndex::may_contain(std::string_view name) const {
+    return header_ && bloom_may_contain(bloom_, header_->bloom_blocks, name);
+}
+
+uint32_t RepoIndex::find(std::string_view name) const {
+    if (!may_contain(name)) return REPO_INDEX_NPOS;
+    // Last shard whose first name is <= name.
+    const ShardEntry* first = shards_;
+    const ShardEntry* last = shards_ + shard_count();
+    const ShardEntry* entry = std::upper_bound(first, last, name,
+        [this](std::string_view key, const ShardEntry& e) { return key < str(e.first_name); });
+    if (entry == first) return REPO_INDEX_NPOS;
+    --entry;
+    const Shard* shard = load_shard(static_cast<uint32_t>(entry - first));
+    if (!shard) return REPO_INDEX_NPOS;
+
+    const IndexRecord* begin = shard->records;
+    const IndexRecord* end = shard->records + entry->package_count;
+    const IndexRecord* it = std::lower_bound(begin, end, name,
+        [shard](const IndexRecord& rec, std::string_view key) { return shard->str(rec.name) < key; });
+    if (it == end || shard->str(it->name) != name) return REPO_INDEX_NPOS;
+    return entry->first_package + static_cast<uint32_t>(it - begin);
+}
+
+PackageView RepoIndex::package(uint32_t id) const {
+    PackageView view;
+    const Shard* shard = shard_of(id);
+    if (!shard) return view;
+    const IndexRecord& rec = shard->records[id % REPO_INDEX_SHARD_PACKAGES];
+    view.name = shard->str(rec.name);
+    view.version = shard->str(rec.version);
+    view.version_key = shard->str(rec.version_key);
+    view.description = shard->str(rec.description);
+    view.arch = shard->str(rec.arch);
+    view.license = shard->str(rec.license);
+    view.maintainer = shard->str(rec.maintainer);
+    view.url = shard->str(rec.url);
+    view.repository = shard->str(rec.repository);
+    view.id = id;
+    view.deps_count = rec.deps_count;
+    return view;
+}
+
+std::string_view RepoIndex::name(uint32_t id) const {
+    const Shard* shard = shard_of(id);
+    return shard ? shard->str(shard->records[id % REPO_INDEX_SHARD_PACKAGES].name) : std::string_view();
+}
+
+DependencyView RepoIndex::dependency(const PackageView& pkg, uint32_t i) const {
+    DependencyView view;
+    const Shard* shard = shard_of(pkg.id);
+    if (!shard) return view;
+    const DepRecord& dep = shard->deps[shard->records[pkg.id % REPO_INDEX_SHARD_PACKAGES].deps_begin + i];
+    view.raw = shard->str(dep.raw);
+    view.name = view.raw.substr(0, dep.name_length);
+    view.package = dep.package;
+    view.op = dep.op;
+    view.flags = dep.flags;
+    view.version_key = shard->str(dep.version_key);
+    return view;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "repo_bloom.hpp"
+#include "repo_scan.hpp"
+#include "repo_version.hpp"
+
+// Binary repository index.
+//
+// The index is a read-only snapshot of repo.json laid out so it can be
+// mmap'd and queried without any parsing. Packages are sorted by name and cut
+// into contiguous shards of up to REPO_INDEX_SHARD_PACKAGES records; a small
+// directory file lists where each shard starts:
+//
+//   <index>              IndexHeader, ShardEntry[shard_count], char[strings_size],
+//                        BloomBlock[bloom_blocks] (see repo_bloom.hpp)
+//   <index>.shards/<h>.terms  inverted index for search (see repo_search.hpp)
+//   <index>.shards/<h>.trigrams  trigram index (see repo_trigram.hpp)
+//   <index>.shards/<h>.names  packed name table (see repo_fuzzy.hpp)
+//   <index>.shards/<h>.text  packed name and description text (see repo_trigram.hpp)
+//   <index>.shards/<h>.columns  dictionary-encoded columns (see repo_query.hpp)
+//   <index>.shards/<h>.trie  name trie for shell completion (see repo_complete.hpp)
+//   <index>.shards/<h>.graph  dependency graph (see repo_graph.hpp)
+//   <index>.shards/<h>.shard  ShardHeader
+//                        IndexRecord[package_count]   fixed-width, sorted by name
+//                        DepRecord[dependency_count]  referenced by records
+//                        char[strings_size]           interned string table (each
+//                                                     distinct string stored once,
+//                                                     not terminated)
+//
+// Package ids are global positions in name order; a shard covers the ids
+// [first_package, first_package + package_count). Only the directory is
+// mapped when the index is opened, and a shard is mapped the first time a
+// lookup lands in it, so resolving one package and its dependencies touches
+// only the shards along that closure.
+//
+// Shard files are named after the hash of their contents and never modified.
+// A rebuild writes the shards whose contents changed, then swaps in a new
+// directory. Dependencies store global ids and shards are fixed runs of ids,
+// so adding or removing a package changes every shard from its position on;
+// only changes that keep the set of names (new versions, descriptions) leave
+// the other shards as they are. Files no longer referenced are removed an
+// hour after the directory naming them was replaced, so a rebuild can briefly
+// keep two copies of the index on disk. A reader that outlives that must
+// check replaced() and open the index again.
+//
+// All integers are stored in host byte order; the index is a local cache and
+// is never shipped between machines. The directory records the identity of
+// the repo.json it was built from (see SourceStamp) so a stale index is
+// detected without re-parsing anything.
+
+constexpr char REPO_INDEX_MAGIC[8] = {'F', 'O', 'X', 'I', 'D', 'X', '\0', '\0'};
+constexpr char REPO_SHARD_MAGIC[8] = {'F', 'O', 'X', 'S', 'H', 'R', 'D', '\0'};
+constexpr uint32_t REPO_INDEX_VERSION = 17;
+constexpr uint32_t REPO_INDEX_NPOS = 0xffffffffu;
+constexpr uint32_t REPO_INDEX_SHARD_PACKAGES = 1024;
+
+struct StrRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// A dependency such as "glibc>=2.31": the raw text, the length of its
+// package-name prefix, the id of that package in this index (or
+// REPO_INDEX_NPOS when the repository does not carry it), and the constraint
+// parsed into an operator and a version sort key (see repo_version.hpp).
+//
+// A package's records list its dependencies, then its conflicts, then the
+// names it provides (flagged DEP_PROVIDES, with no target). A dependency with
+// alternatives ("mta | sendmail") takes one record per alternative, all but
+// the first flagged DEP_ALTERNATIVE. An unversioned dependency or conflict
+// on a name that other packages provide is followed by one record per
+// provider, flagged DEP_PROVIDER, whose raw text is the provider's name; for
+// a dependency they are further alternatives.
+struct DepRecord {
+    StrRef raw;
+    uint32_t name_length;
+    uint32_t package;
+    StrRef version_key;
+    ConstraintOp op;
+    uint32_t flags;
+};
+
+constexpr uint32_t DEP_ALTERNATIVE = 1;  // another way to meet the record before
+constexpr uint32_t DEP_CONFLICT = 2;     // must not be installed alongside
+constexpr uint32_t DEP_PROVIDER = 4;     // provides the name of the record before
+constexpr uint32_t DEP_PROVIDES = 8;     // a name the package provides
+
+struct IndexRecord {
+    StrRef name;
+    StrRef version;
+    StrRef description;
+    StrRef arch;
+    StrRef license;
+    StrRef maintainer;
+    StrRef url;
+    StrRef repository;  // name of the configured repository it came from
+    StrRef version_key;
+    uint32_t deps_begin;  // within the shard's DepRecord table
+    uint32_t deps_count;
+};
+
+// Identity of the file an index was built from. hash is the XXH64 of the
+// exact bytes that were indexed.
+struct SourceStamp {
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t hash;
+};
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    uint32_t dependency_count;
+    uint32_t shard_count;
+    uint64_t shards_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    SourceStamp source;
+    int64_t built_at_ns;
+    StrRef terms_file;     // file names within <index>.shards
+    StrRef trigrams_file;
+    StrRef names_file;
+    StrRef text_file;
+    StrRef columns_file;
+    StrRef trie_file;
+    StrRef graph_file;
+    uint64_t bloom_offset;  // 32-byte aligned, after the strings
+    uint32_t bloom_blocks;
+    uint32_t reserved;
+};
+
+struct ShardEntry {
+    uint32_t first_package;
+    uint32_t package_count;
+    StrRef first_name;  // in the directory's string table
+    StrRef file;        // file name within <index>.shards
+};
+
+struct ShardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    uint32_t dependency_count;
+    uint32_t reserved;
+    uint64_t records_offset;
+    uint64_t deps_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct DependencyView {
+    std::string_view name;
+    std::string_view raw;
+    uint32_t package = REPO_INDEX_NPOS;
+    ConstraintOp op = ConstraintOp::Any;
+    std::string_view version_key;
+    uint32_t flags = 0;
+
+    // Whether a version with sort key key meets this dependency.
+    bool satisfied_by(std::string_view key) const { return version_satisfies(key, op, version_key); }
+    bool alternative() const { return flags & DEP_ALTERNATIVE; }
+    bool conflict() const { return flags & DEP_CONFLICT; }
+    bool provider() const { return flags & DEP_PROVIDER; }
+    bool provides() const { return flags & DEP_PROVIDES; }
+};
+
+// Lightweight view of one package; every field points into the mapping.
+struct PackageView {
+    std::string_view name;
+    std::string_view version;
+    std::string_view version_key;
+    std::string_view description;
+    std::string_view arch;
+    std::string_view license;
+    std::string_view maintainer;
+    std::string_view url;
+    std::string_view repository;
+    uint32_t id = REPO_INDEX_NPOS;
+    uint32_t deps_count = 0;  // dependency records, conflicts and provides included
+};
+
+// Serialize the packages parsed from repo.json into an index at index_path.
+// Strings are interned (per shard) and dependencies are resolved to package
+// ids here, once, rather than on every lookup.
+// Shards are written first and the directory is renamed into place last, so
+// concurrent readers never observe a partial index.
+//
+// repository names the repository for records that do not carry their own.
+// The header is stamped from repo.file; an index that was not built from a
+// single file (see repo_merge.hpp) passes its own source stamp instead.
+bool build_repo_index(const RepoRecords& repo, const std::string& index_path,
+                      std::string_view repository = {}, const SourceStamp* source = nullptr);
+
+class RepoIndex {
+public:
+    // Map the index directory read-only. Returns false if the file is
+    // missing, truncated or was written by an incompatible version of fox.
+    bool open(const std::string& index_path);
+
+    // Map the index only if it still describes source_path. Inode, size and
+    // mtime are compared first. If they differ but the size matches, or the
+    // mtime is too close to the build time to be trusted, the source is hashed
+    // and compared with the recorded hash; on a match the stamp is refreshed
+    // in place so the next run takes the fast path again.
+    bool open_if_current(const std::string& index_path, const std::string& source_path);
+
+    const SourceStamp& source() const { return header_->source; }
+    const std::string& path() const { return index_path_; }
+    // Whether another directory has been swapped in at path() since this
+    // one was opened. Files only this one names are removed an hour later.
+    bool replaced() const;
+    void close();
+    bool is_open() const { return header_ != nullptr; }
+
+    uint32_t size() const { return header_ ? header_->package_count : 0; }
+    uint32_t shard_count() const { return header_ ? header_->shard_count : 0; }
+    // Shards mapped so far.
+    uint32_t loaded_shard_count() const;
+    // Side files read by search_repo_index(), search_substring(),
+    // fuzzy_search(), run_query(), complete_names() and DependencyGraph.
+    std::string terms_path() const { return side_path(header_->terms_file); }
+    std::string trigrams_path() const { return side_path(header_->trigrams_file); }
+    std::string names_path() const { return side_path(header_->names_file); }
+    std::string text_path() const { return side_path(header_->text_file); }
+    std::string columns_path() const { return side_path(header_->columns_file); }
+    std::string trie_path() const { return side_path(header_->trie_file); }
+    std::string graph_path() const { return side_path(header_->graph_file); }
+
+    // False if the index certainly has no package called name. Reads one
+    // cache line of the directory and never maps a shard.
+    bool may_contain(std::string_view name) const;
+
+    // Bloom filter check, then binary search over the shard directory and
+    // over the sorted name table of that shard; REPO_INDEX_NPOS if absent.
+    uint32_t find(std::string_view name) const;
+
+    // Views of a package whose shard cannot be mapped are empty, with id
+    // REPO_INDEX_NPOS.
+    PackageView package(uint32_t id) const;
+    std::string_view name(uint32_t id) const;
+    DependencyView dependency(const PackageView& pkg, uint32_t i) const;
+
+private:
+    struct Shard {
+        MappedFile file;
+        const IndexRecord* records = nullptr;
+        const DepRecord* deps = nullptr;
+        const char* strings = nullptr;
+
+        std::string_view str(const StrRef& ref) const {
+            return std::string_view(strings + ref.offset, ref.length);
+        }
+    };
+
+    std::string_view str(const StrRef& ref) const {
+        return std::string_view(strings_ + ref.offset, ref.length);
+    }
+    std::string side_path(const StrRef& file) const { return shard_dir_ + "/" + std::string(str(file)); }
+    // Shard holding package id, mapped on first use; nullptr if it cannot
+    // be mapped.
+    const Shard* shard_of(uint32_t id) const;
+    const Shard* load_shard(uint32_t s) const;
+
+    MappedFile file_;
+    const IndexHeader* header_ = nullptr;
+    const ShardEntry* shards_ = nullptr;
+    const char* strings_ = nullptr;
+    const BloomBlock* bloom_ = nullptr;
+    std::string index_path_;
+    std::string shard_dir_;
+    mutable std::vector<Shard> loaded_;
+};
@@ -0,0 +1,112 @@
+#include "repo_merge.hpp"
+
+#include <queue>
+
+#include "content_hash.hpp"
+
+namespace {
+
+struct Cursor {
+    std::string_view name;
+    uint32_t input;  // position in the priority order
+    uint32_t id;     // current package in that input
+};
+
+// Orders the heap so the smallest name comes out first and, for equal
+// names, the highest-priority input.
+struct CursorAfter {
+    bool operator()(const Cursor& a, const Cursor& b) const {
+        if (a.name != b.name) return a.name > b.name;
+        return a.input > b.input;
+    }
+};
+
+void mix(uint64_t& key, const void* data, std::size_t size) {
+    key = content_hash64(data, size, key);
+}
+
+} // namespace
+
+uint64_t merge_key(const std::vector<MergeInput>& inputs) {
+    uint64_t key = REPO_INDEX_VERSION;
+    for (const MergeInput& in : inputs) {
+        uint64_t length = in.repository.size();
+        mix(key, &length, sizeof(length));
+        mix(key, in.repository.data(), in.repository.size());
+        // Only size and content: a touched or re-fetched but identical
+        // repo.json must not force a new merge.
+        mix(key, &in.index->source().size, sizeof(uint64_t));
+        mix(key, &in.index->source().hash, sizeof(uint64_t));
+    }
+    return key;
+}
+
+bool build_merged_index(const std::vector<MergeInput>& inputs, const std::string& index_path) {
+    RepoRecords merged;
+    std::priority_queue<Cursor, std::vector<Cursor>, CursorAfter> heap;
+    std::size_t total = 0;
+    for (uint32_t i = 0; i < inputs.size(); ++i) {
+        total += inputs[i].index->size();
+        if (inputs[i].index->size() > 0) heap.push({inputs[i].index->name(0), i, 0});
+    }
+    merged.packages.reserve(total);
+
+    std::string_view last;
+    while (!heap.empty()) {
+        Cursor top = heap.top();
+        heap.pop();
+        const RepoIndex& index = *inputs[top.input].index;
+        if (top.id + 1 < index.size()) heap.push({index.name(top.id + 1), top.input, top.id + 1});
+        // Lower-priority copies of a name already taken are shadowed.
+        if (!merged.packages.empty() && top.name == last) continue;
+        last = top.name;
+
+        PackageView pkg = index.package(top.id);
+        RepoRecord rec;
+        rec.name = pkg.name;
+        rec.version = pkg.version;
+        rec.description = pkg.description;
+        rec.arch = pkg.arch;
+        rec.license = pkg.license;
+        rec.maintainer = pkg.maintainer;
+        rec.url = pkg.url;
+        rec.repository = inputs[top.input].repository;
+        rec.deps_begin = static_cast<uint32_t>(merged.dependencies.size());
+        rec.conflicts_begin = static_cast<uint32_t>(merged.conflicts.size());
+        rec.provides_begin = static_cast<uint32_t>(merged.provides.size());
+        for (uint32_t d = 0; d < pkg.deps_count; ++d) {
+            DependencyView dep = index.dependency(pkg, d);
+            // Providers are found again across all inputs.
+            if (dep.flags & DEP_PROVIDER) continue;
+            if (dep.flags & DEP_PROVIDES) {
+                merged.provides.push_back(dep.raw);
+            } else if (dep.flags & DEP_CONFLICT) {
+                merged.conflicts.push_back(dep.raw);
+            } else if ((dep.flags & DEP_ALTERNATIVE) && merged.dependencies.size() > rec.deps_begin) {
+                // Alternatives are indexed one by one; join them back up.
+                std::string joined = std::string(merged.dependencies.back()) + " | " + std::string(dep.raw);
+                merged.dependencies.back() = merged.arena.store(joined);
+            } else {
+                merged.dependencies.push_back(dep.raw);
+            }
+        }
+        rec.deps_count = static_cast<uint32_t>(merged.dependencies.size()) - rec.deps_begin;
+        rec.conflicts_count = static_cast<uint32_t>(merged.conflicts.size()) - rec.conflicts_begin;
+        rec.provides_count = static_cast<uint32_t>(merged.provides.size()) - rec.provides_begin;
+        merged.packages.push_back(rec);
+    }
+
+    SourceStamp stamp{};
+    stamp.size = inputs.size();
+    stamp.hash = merge_key(inputs);
+    return build_repo_index(merged, index_path, {}, &stamp);
+}
+
+bool open_merged_index(const std::vector<MergeInput>& inputs, const std::string& index_path, RepoIndex& merged) {
+    if (merged.open(index_path) && merged.source().size == inputs.size() &&
+        merged.source().hash == merge_key(inputs)) {
+        return true;
+    }
+    merged.close();
+    return build_merged_index(inputs, index_path) && merged.open(index_path);
+}
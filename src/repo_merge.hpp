@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "repo_index.hpp"
+
+// Merged view over several repositories.
+//
+// Each repository has its own binary index, sorted by package name. The
+// merged index is produced by a k-way merge of those sorted tables: a
+// min-heap holds one cursor per repository, so every package is visited once
+// and the output comes out already in name order. When a name is present in
+// more than one repository the highest-priority one wins.
+//
+// The result is an ordinary RepoIndex file. Its source stamp carries a key
+// derived from the repository names, their order and the content hash of
+// every input, so it is reused until one of the inputs actually changes.
+
+// One input to the merge. Inputs are passed highest priority first.
+struct MergeInput {
+    const RepoIndex* index;
+    std::string_view repository;
+};
+
+// Key identifying a particular set of inputs.
+uint64_t merge_key(const std::vector<MergeInput>& inputs);
+
+// Merge inputs into a new index at index_path.
+bool build_merged_index(const std::vector<MergeInput>& inputs, const std::string& index_path);
+
+// Map the merged index at index_path into merged, rebuilding it first if it
+// was produced from different inputs.
+bool open_merged_index(const std::vector<MergeInput>& inputs, const std::string& index_path, RepoIndex& merged);
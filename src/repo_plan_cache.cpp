@@ -0,0 +1,151 @@
+#include "repo_plan_cache.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+#include "content_hash.hpp"
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr const char* PLAN_CACHE_MAGIC = "fox-plan-cache";
+constexpr int PLAN_CACHE_VERSION = 1;
+
+std::string key_hex(uint64_t key) {
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016" PRIx64, key);
+    return hex;
+}
+
+// Ids of names, or false if one is no longer in the index.
+bool package_ids(const RepoIndex& index, const json& names, std::vector<uint32_t>& ids) {
+    if (!names.is_array()) return false;
+    for (const json& name : names) {
+        if (!name.is_string()) return false;
+        uint32_t id = index.find(name.get_ref<const std::string&>());
+        if (id == REPO_INDEX_NPOS) return false;
+        ids.push_back(id);
+    }
+    return true;
+}
+
+json package_names(const RepoIndex& index, const std::vector<uint32_t>& ids) {
+    json names = json::array();
+    for (uint32_t id : ids) names.push_back(std::string(index.name(id)));
+    return names;
+}
+
+// Remove the least recently used entries beyond PLAN_CACHE_MAX_ENTRIES.
+void trim_plan_cache(const std::filesystem::path& dir) {
+    std::error_code ec;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        auto time = entry.last_write_time(ec);
+        if (!ec) entries.emplace_back(time, entry.path());
+    }
+    if (entries.size() <= PLAN_CACHE_MAX_ENTRIES) return;
+    std::sort(entries.begin(), entries.end());
+    for (std::size_t i = 0; i < entries.size() - PLAN_CACHE_MAX_ENTRIES; ++i) {
+        std::filesystem::remove(entries[i].second, ec);
+    }
+}
+
+} // namespace
+
+uint64_t plan_cache_key(const RepoIndex& index, const std::vector<uint32_t>& requested, uint64_t installed_digest) {
+    struct {
+        uint32_t version;
+        uint32_t packages;
+        uint64_t source;
+        uint64_t installed;
+    } inputs{REPO_INDEX_VERSION, index.size(), index.source().hash, installed_digest};
+    uint64_t key = content_hash64(&inputs, sizeof(inputs));
+    return content_hash64(requested.data(), requested.size() * sizeof(uint32_t), key);
+}
+
+std::string plan_cache_path(const std::string& cache_dir, uint64_t key) {
+    return cache_dir + "/plans/" + key_hex(key);
+}
+
+bool load_cached_plan(const std::string& path, uint64_t key, const RepoIndex& index, InstallPlan& plan) {
+    std::ifstream in(path, std::ios::binary);
+    std::string line;
+    if (!std::getline(in, line)) return false;
+    char magic[32] = {};
+    int version = 0;
+    char stored_key[32] = {};
+    if (std::sscanf(line.c_str(), "%31s %d %31s", magic, &version, stored_key) != 3 ||
+        std::string(magic) != PLAN_CACHE_MAGIC || version != PLAN_CACHE_VERSION || stored_key != key_hex(key)) {
+        return false;
+    }
+    if (!std::getline(in, line)) return false;
+    json entry = json::parse(line, nullptr, false);
+    if (!entry.is_object()) return false;
+
+    InstallPlan cached;
+    if (!package_ids(index, entry.value("packages", json()), cached.packages)) return false;
+    const json cycles = entry.value("cycles", json::array());
+    const json problems = entry.value("problems", json::array());
+    if (!cycles.is_array() || !problems.is_array()) return false;
+    for (const json& cycle : cycles) {
+        cached.cycles.emplace_back();
+        if (!package_ids(index, cycle, cached.cycles.back())) return false;
+    }
+    for (const json& problem : problems) {
+        if (!problem.is_object()) return false;
+        ResolveProblem p;
+        p.package = problem.value("package", "");
+        p.message = problem.value("message", "");
+        auto explanation = problem.find("explanation");
+        if (explanation != problem.end() && explanation->is_array()) {
+            for (const json& rule : *explanation) {
+                if (rule.is_string()) p.explanation.push_back(rule.get<std::string>());
+            }
+        }
+        cached.problems.push_back(std::move(p));
+    }
+    plan = std::move(cached);
+    // Mark the entry as recently used so trimming keeps it.
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    return true;
+}
+
+bool store_cached_plan(const std::string& path, uint64_t key, const RepoIndex& index, const InstallPlan& plan) {
+    json cycles = json::array();
+    for (const std::vector<uint32_t>& cycle : plan.cycles) cycles.push_back(package_names(index, cycle));
+    json problems = json::array();
+    for (const ResolveProblem& problem : plan.problems) {
+        problems.push_back(
+            {{"package", problem.package}, {"message", problem.message}, {"explanation", problem.explanation}});
+    }
+    json entry = {{"packages", package_names(index, plan.packages)},
+                  {"cycles", std::move(cycles)},
+                  {"problems", std::move(problems)}};
+
+    const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << PLAN_CACHE_MAGIC << ' ' << PLAN_CACHE_VERSION << ' ' << key_hex(key) << '\n'
+            << entry.dump(-1, ' ', false, json::error_handler_t::replace) << '\n';
+        if (!out) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    trim_plan_cache(dir);
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "repo_index.hpp"
+#include "repo_resolve.hpp"
+
+// Cached install plans.
+//
+// Resolving the same request against the same index and the same installed
+// packages always gives the same plan, so plans are kept under
+// <cache>/plans, one file per key. The key hashes everything the resolver
+// reads:
+//
+//   - the index: its format version, package count and the content hash of
+//     the repo.json it was built from (for a merged index, the hash of its
+//     inputs), which changes with every new generation fetched;
+//   - the requested package ids, in the order given, since the order decides
+//     which request is dropped first and how independent ones are planned;
+//   - a digest of the installed packages and their versions.
+//
+// Any change in one of them gives a different key, so a stale entry is never
+// read; it is removed once the directory holds more than
+// PLAN_CACHE_MAX_ENTRIES files, least recently used first. An entry stores
+// package names rather than ids and is only used if every name is still in
+// the index.
+//
+//   fox-plan-cache <version> <key>
+//   {"packages": [...], "cycles": [[...]], "problems": [{...}]}
+
+constexpr uint32_t PLAN_CACHE_MAX_ENTRIES = 256;
+
+uint64_t plan_cache_key(const RepoIndex& index, const std::vector<uint32_t>& requested, uint64_t installed_digest);
+
+// Where the plan for key lives under cache_dir.
+std::string plan_cache_path(const std::string& cache_dir, uint64_t key);
+
+// Read the plan stored at path for key. False if there is none or it no
+// longer fits index.
+bool load_cached_plan(const std::string& path, uint64_t key, const RepoIndex& index, InstallPlan& plan);
+
+// Store plan at path, then trim the directory to PLAN_CACHE_MAX_ENTRIES.
+bool store_cached_plan(const std::string& path, uint64_t key, const RepoIndex& index, const InstallPlan& plan);
@@ -0,0 +1,444 @@
+#include "repo_query.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "mapped_file.hpp"
+#include "repo_trigram.hpp"
+#include "repo_version.hpp"
+
+namespace {
+
+const char* const FIELD_NAMES[QUERY_FIELD_COUNT] = {"arch", "license", "maintainer", "depends"};
+
+unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+bool equal_ignore_case(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (fold(static_cast<unsigned char>(a[i])) != fold(static_cast<unsigned char>(b[i]))) return false;
+    }
+    return true;
+}
+
+// ---- Building ----
+
+void append_u32s(std::string& out, const std::vector<uint32_t>& values) {
+    out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(uint32_t));
+}
+
+// Dictionary-encode one column. rows is empty for single-valued columns.
+void append_column(std::string& out, const std::vector<std::string_view>& row_values,
+                   const std::vector<uint32_t>& rows, ColumnInfo& info) {
+    std::vector<std::string_view> dictionary(row_values);
+    std::sort(dictionary.begin(), dictionary.end());
+    dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+    std::unordered_map<std::string_view, uint32_t> code_of;
+    code_of.reserve(dictionary.size());
+    for (uint32_t code = 0; code < dictionary.size(); ++code) code_of.emplace(dictionary[code], code);
+
+    std::vector<uint32_t> codes;
+    codes.reserve(row_values.size());
+    for (std::string_view value : row_values) codes.push_back(code_of[value]);
+    std::vector<uint32_t> value_offsets;
+    value_offsets.reserve(dictionary.size() + 1);
+    std::string blob;
+    for (std::string_view value : dictionary) {
+        value_offsets.push_back(static_cast<uint32_t>(blob.size()));
+        blob.append(value);
+    }
+    value_offsets.push_back(static_cast<uint32_t>(blob.size()));
+
+    info.value_count = static_cast<uint32_t>(dictionary.size());
+    info.row_count = static_cast<uint32_t>(codes.size());
+    info.rows_offset = 0;
+    if (!rows.empty()) {
+        info.rows_offset = out.size();
+        append_u32s(out, rows);
+    }
+    info.codes_offset = out.size();
+    append_u32s(out, codes);
+    info.values_offset = out.size();
+    append_u32s(out, value_offsets);
+    info.values_size = blob.size();
+    out.append(blob);
+    // Keep the next column's arrays aligned.
+    out.append((4 - out.size() % 4) % 4, '\0');
+}
+
+// ---- Parsing ----
+
+struct Token {
+    enum Kind { Word, Open, Close } kind;
+    std::string text;
+    bool quoted = false;  // the word contained quotes, so it is never an operator
+};
+
+bool tokenize(std::string_view query, std::vector<Token>& tokens, std::string& error) {
+    std::size_t i = 0;
+    while (i < query.size()) {
+        char c = query[i];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            ++i;
+        } else if (c == '(' || c == ')') {
+            tokens.push_back({c == '(' ? Token::Open : Token::Close, {}});
+            ++i;
+        } else {
+            Token word{Token::Word, {}};
+            while (i < query.size() && query[i] != ' ' && query[i] != '\t' && query[i] != '\n' &&
+                   query[i] != '\r' && query[i] != '(' && query[i] != ')') {
+                if (query[i] == '"') {
+                    std::size_t close = query.find('"', i + 1);
+                    if (close == std::string_view::npos) {
+                        error = "unterminated quote";
+                        return false;
+                    }
+                    word.text.append(query.substr(i + 1, close - i - 1));
+                    word.quoted = true;
+                    i = close + 1;
+                } else {
+                    word.text.push_back(query[i++]);
+                }
+            }
+            tokens.push_back(std::move(word));
+        }
+    }
+    return true;
+}
+
+// Length of a leading "field:" (letters then a colon), or 0.
+std::size_t field_prefix_length(std::string_view word) {
+    std::size_t i = 0;
+    while (i < word.size() && fold(static_cast<unsigned char>(word[i])) >= 'a' &&
+           fold(static_cast<unsigned char>(word[i])) <= 'z') {
+        ++i;
+    }
+    return i > 0 && i < word.size() && word[i] == ':' ? i + 1 : 0;
+}
+
+// The field a field:value word names, or QUERY_FIELD_COUNT if its prefix is
+// not one of FIELD_NAMES.
+std::size_t known_field(std::string_view word) {
+    std::size_t prefix = field_prefix_length(word);
+    if (prefix == 0) return QUERY_FIELD_COUNT;
+    std::string_view name = word.substr(0, prefix - 1);
+    std::size_t field = 0;
+    while (field < QUERY_FIELD_COUNT && !equal_ignore_case(name, FIELD_NAMES[field])) ++field;
+    return field;
+}
+
+bool is_operator(const Token& token, const char* name) {
+    return token.kind == Token::Word && !token.quoted && token.text == name;
+}
+
+// Recursive descent over the tokens, emitting postfix code:
+//   or   := and { OR and }
+//   and  := not { [AND] not }
+//   not  := NOT not | primary
+//   primary := '(' or ')' | term
+class Parser {
+public:
+    Parser(const std::vector<Token>& tokens, Query& out, std::string& error)
+        : tokens_(tokens), out_(out), error_(error) {}
+
+    bool parse() {
+        if (tokens_.empty()) return fail("empty query");
+        if (!parse_or()) return false;
+        if (pos_ < tokens_.size()) return fail("unexpected ')'");
+        return true;
+    }
+
+private:
+    bool fail(const std::string& message) {
+        error_ = message;
+        return false;
+    }
+
+    bool at(const char* name) const { return pos_ < tokens_.size() && is_operator(tokens_[pos_], name); }
+
+    bool parse_or() {
+        if (!parse_and()) return false;
+        while (at("OR")) {
+            ++pos_;
+            if (!parse_and()) return false;
+            out_.program.push_back({QueryOp::Or});
+        }
+        return true;
+    }
+
+    bool parse_and() {
+        if (!parse_not()) return false;
+        while (pos_ < tokens_.size() && tokens_[pos_].kind != Token::Close && !at("OR")) {
+            if (at("AND")) ++pos_;
+            if (!parse_not()) return false;
+            out_.program.push_back({QueryOp::And});
+        }
+        return true;
+    }
+
+    bool parse_not() {
+        if (at("NOT")) {
+            ++pos_;
+            if (!parse_not()) return false;
+            out_.program.push_back({QueryOp::Not});
+            return true;
+        }
+        return parse_primary();
+    }
+
+    bool parse_primary() {
+        if (pos_ == tokens_.size()) return fail("expected a search term at end of query");
+        const Token& token = tokens_[pos_];
+        if (token.kind == Token::Open) {
+            ++pos_;
+            if (!parse_or()) return false;
+            if (pos_ == tokens_.size() || tokens_[pos_].kind != Token::Close) return fail("missing ')'");
+            ++pos_;
+            return true;
+        }
+        if (token.kind == Token::Close) return fail("expected a search term before ')'");
+        if (at("AND") || at("OR")) return fail("expected a search term before '" + token.text + "'");
+        ++pos_;
+        return add_term(token.text);
+    }
+
+    bool add_term(const std::string& word) {
+        std::size_t prefix = field_prefix_length(word);
+        if (prefix == 0) {
+            QueryOp op;
+            op.kind = QueryOp::Text;
+            op.value = word;
+            out_.program.push_back(std::move(op));
+            return true;
+        }
+        std::string_view name(word.data(), prefix - 1);
+        std::size_t field = known_field(word);
+        if (field == QUERY_FIELD_COUNT) {
+            return fail("unknown field '" + std::string(name) + "' (expected arch, license, maintainer or depends)");
+        }
+        QueryOp op{QueryOp::Field, static_cast<QueryField>(field), word.substr(prefix)};
+        if (!op.value.empty() && op.value.back() == '*') {
+            op.value.pop_back();
+            op.prefix = true;
+        }
+        if (op.value.empty() && !op.prefix) return fail("missing value after '" + word + "'");
+        out_.program.push_back(std::move(op));
+        return true;
+    }
+
+    const std::vector<Token>& tokens_;
+    Query& out_;
+    std::string& error_;
+    std::size_t pos_ = 0;
+};
+
+// ---- Evaluation ----
+
+using Bitmap = std::vector<uint64_t>;
+
+struct Column {
+    const ColumnInfo* info = nullptr;
+    const uint32_t* rows = nullptr;
+    const uint32_t* codes = nullptr;
+    const uint32_t* value_offsets = nullptr;
+    const char* values = nullptr;
+
+    std::string_view value(uint32_t code) const {
+        return std::string_view(values + value_offsets[code], value_offsets[code + 1] - value_offsets[code]);
+    }
+};
+
+bool load_columns(const MappedFile& file, uint32_t package_count, Column (&columns)[QUERY_FIELD_COUNT]) {
+    if (file.size() < sizeof(ColumnsHeader)) return false;
+    const auto* header = reinterpret_cast<const ColumnsHeader*>(file.data());
+    if (std::memcmp(header->magic, REPO_COLUMNS_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_INDEX_VERSION || header->package_count != package_count) {
+        return false;
+    }
+    auto fits = [&](uint64_t offset, uint64_t bytes) { return offset <= file.size() && bytes <= file.size() - offset; };
+    for (std::size_t f = 0; f < QUERY_FIELD_COUNT; ++f) {
+        const ColumnInfo& info = header->columns[f];
+        bool multi = static_cast<QueryField>(f) == QueryField::Depends;
+        if ((multi ? !fits(info.rows_offset, (uint64_t(package_count) + 1) * sizeof(uint32_t))
+                   : info.row_count != package_count) ||
+            !fits(info.codes_offset, uint64_t(info.row_count) * sizeof(uint32_t)) ||
+            !fits(info.values_offset, (uint64_t(info.value_count) + 1) * sizeof(uint32_t) + info.values_size)) {
+            return false;
+        }
+        Column& column = columns[f];
+        column.info = &info;
+        column.rows = multi ? reinterpret_cast<const uint32_t*>(file.data() + info.rows_offset) : nullptr;
+        column.codes = reinterpret_cast<const uint32_t*>(file.data() + info.codes_offset);
+        column.value_offsets = reinterpret_cast<const uint32_t*>(file.data() + info.values_offset);
+        column.values = file.data() + info.values_offset + (uint64_t(info.value_count) + 1) * sizeof(uint32_t);
+        for (uint32_t code = 0; code < info.value_count; ++code) {
+            if (column.value_offsets[code] > column.value_offsets[code + 1]) return false;
+        }
+        if (column.value_offsets[info.value_count] > info.values_size) return false;
+    }
+    return true;
+}
+
+// Packages whose value in column matches op.
+Bitmap match_column(const Column& column, const QueryOp& op, uint32_t package_count) {
+    Bitmap bits((package_count + 63) / 64, 0);
+    const uint32_t value_count = column.info->value_count;
+    // Resolve the term against the dictionary once.
+    std::vector<uint8_t> wanted(value_count, 0);
+    uint32_t matched = 0;
+    uint32_t only = 0;
+    for (uint32_t code = 0; code < value_count; ++code) {
+        std::string_view value = column.value(code);
+        if (op.prefix ? value.size() >= op.value.size() && equal_ignore_case(value.substr(0, op.value.size()), op.value)
+                      : equal_ignore_case(value, op.value)) {
+            wanted[code] = 1;
+            only = code;
+            ++matched;
+        }
+    }
+    if (matched == 0) return bits;
+
+    const uint32_t* codes = column.codes;
+    if (!column.rows) {
+        for (uint32_t base = 0; base < package_count; base += 64) {
+            uint32_t end = std::min(base + 64, package_count);
+            uint64_t word = 0;
+            if (matched == 1) {
+                for (uint32_t id = base; id < end; ++id) word |= uint64_t(codes[id] == only) << (id - base);
+            } else {
+                for (uint32_t id = base; id < end; ++id) {
+                    word |= uint64_t(codes[id] < value_count && wanted[codes[id]]) << (id - base);
+                }
+            }
+            bits[base / 64] = word;
+        }
+        return bits;
+    }
+    const uint32_t row_count = column.info->row_count;
+    for (uint32_t id = 0; id < package_count; ++id) {
+        uint32_t end = std::min(column.rows[id + 1], row_count);
+        for (uint32_t row = column.rows[id]; row < end; ++row) {
+            if (codes[row] < value_count && wanted[codes[row]]) {
+                bits[id / 64] |= uint64_t(1) << (id % 64);
+                break;
+            }
+        }
+    }
+    return bits;
+}
+
+} // namespace
+
+std::string build_column_index(const RepoRecords& repo, const std::vector<const RepoRecord*>& packages) {
+    const std::size_t n = packages.size();
+    std::vector<std::string_view> values[QUERY_FIELD_COUNT];
+    for (auto& column : values) column.reserve(n);
+    std::vector<uint32_t> dependency_rows;
+    dependency_rows.reserve(n + 1);
+    std::vector<std::string_view> alternatives;
+    for (const RepoRecord* pkg : packages) {
+        values[static_cast<std::size_t>(QueryField::Arch)].push_back(pkg->arch);
+        values[static_cast<std::size_t>(QueryField::License)].push_back(pkg->license);
+        values[static_cast<std::size_t>(QueryField::Maintainer)].push_back(pkg->maintainer);
+        auto& depends = values[static_cast<std::size_t>(QueryField::Depends)];
+        dependency_rows.push_back(static_cast<uint32_t>(depends.size()));
+        for (uint32_t k = 0; k < pkg->deps_count; ++k) {
+            split_alternatives(repo.dependencies[pkg->deps_begin + k], alternatives);
+            for (std::string_view dep : alternatives) depends.push_back(dep.substr(0, dependency_name_length(dep)));
+        }
+    }
+    dependency_rows.push_back(static_cast<uint32_t>(values[static_cast<std::size_t>(QueryField::Depends)].size()));
+
+    ColumnsHeader header{};
+    std::memcpy(header.magic, REPO_COLUMNS_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.package_count = static_cast<uint32_t>(n);
+    std::string bytes(sizeof(ColumnsHeader), '\0');
+    for (std::size_t f = 0; f < QUERY_FIELD_COUNT; ++f) {
+        bool multi = static_cast<QueryField>(f) == QueryField::Depends;
+        append_column(bytes, values[f], multi ? dependency_rows : std::vector<uint32_t>(), header.columns[f]);
+    }
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+bool is_structured_query(std::string_view query) {
+    std::size_t i = 0;
+    while (i < query.size()) {
+        std::size_t end = query.find_first_of(" \t\n\r", i);
+        if (end == std::string_view::npos) end = query.size();
+        std::string_view word = query.substr(i, end - i);
+        while (!word.empty() && word.front() == '(') word.remove_prefix(1);
+        if (known_field(word) < QUERY_FIELD_COUNT) return true;
+        i = end + 1;
+    }
+    return false;
+}
+
+bool parse_query(std::string_view query, Query& out, std::string& error) {
+    out.program.clear();
+    std::vector<Token> tokens;
+    if (!tokenize(query, tokens, error)) return false;
+    return Parser(tokens, out, error).parse();
+}
+
+bool run_query(const RepoIndex& index, const Query& query, std::vector<uint32_t>& matches) {
+    matches.clear();
+    const uint32_t package_count = static_cast<uint32_t>(index.size());
+    const std::size_t words = (package_count + 63) / 64;
+    MappedFile file;
+    Column columns[QUERY_FIELD_COUNT];
+    bool needs_columns = std::any_of(query.program.begin(), query.program.end(),
+                                     [](const QueryOp& op) { return op.kind == QueryOp::Field; });
+    if (needs_columns && (!file.open(index.columns_path()) || !load_columns(file, package_count, columns))) {
+        return false;
+    }
+
+    std::vector<Bitmap> stack;
+    for (const QueryOp& op : query.program) {
+        switch (op.kind) {
+        case QueryOp::Field:
+            stack.push_back(match_column(columns[static_cast<std::size_t>(op.field)], op, package_count));
+            break;
+        case QueryOp::Text: {
+            std::vector<uint32_t> ids;
+            if (!search_substring(index, op.value, false, ids)) return false;
+            Bitmap bits(words, 0);
+            for (uint32_t id : ids) bits[id / 64] |= uint64_t(1) << (id % 64);
+            stack.push_back(std::move(bits));
+            break;
+        }
+        case QueryOp::And:
+        case QueryOp::Or: {
+            if (stack.size() < 2) return false;
+            Bitmap right = std::move(stack.back());
+            stack.pop_back();
+            Bitmap& left = stack.back();
+            if (op.kind == QueryOp::And) {
+                for (std::size_t w = 0; w < words; ++w) left[w] &= right[w];
+            } else {
+                for (std::size_t w = 0; w < words; ++w) left[w] |= right[w];
+            }
+            break;
+        }
+        case QueryOp::Not: {
+            if (stack.empty()) return false;
+            Bitmap& bits = stack.back();
+            for (std::size_t w = 0; w < words; ++w) bits[w] = ~bits[w];
+            if (package_count % 64) bits[words - 1] &= (uint64_t(1) << (package_count % 64)) - 1;
+            break;
+        }
+        }
+    }
+    if (stack.size() != 1) return false;
+
+    for (std::size_t w = 0; w < words; ++w) {
+        for (uint64_t word = stack[0][w]; word; word &= word - 1) {
+            matches.push_back(static_cast<uint32_t>(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "repo_index.hpp"
+
+// Field-qualified package queries.
+//
+//   fox search 'license:GPL* AND maintainer:GNOME*'
+//   fox search 'depends:gtk NOT arch:i686'
+//
+// A term is either field:value, matched against one column, or a plain word,
+// matched like a plain `fox search`: as an exact substring of the name or
+// description.
+// Values are compared ignoring ASCII case; a trailing '*' makes the value a
+// prefix, and double quotes allow spaces (maintainer:"Bram Moolenaar").
+// Terms are combined with AND (also implied between adjacent terms), OR and
+// NOT, in that order of precedence from loosest to tightest, and grouped
+// with parentheses.
+//
+// The columns are stored next to the binary index, dictionary-encoded:
+// each field's distinct values are kept once, sorted, and every package
+// stores the code of its value. A term is resolved against the (small)
+// dictionary first, so the per-package test is an integer compare or a
+// table lookup, evaluated over the whole column into a bitmap; boolean
+// operators then combine bitmaps 64 packages at a time.
+//
+//   ColumnsHeader
+//   per column: uint32_t[package_count + 1]  multi-valued columns only:
+//                                            each package's range of codes
+//               uint32_t[row_count]          value codes
+//               uint32_t[value_count + 1]    offset of each value in the blob
+//               char[values_size]            distinct values, sorted
+
+constexpr char REPO_COLUMNS_MAGIC[8] = {'F', 'O', 'X', 'C', 'O', 'L', 'S', '\0'};
+
+// None marks ops that do not read a column (Text and the operators).
+enum class QueryField : uint32_t { Arch, License, Maintainer, Depends, None };
+constexpr std::size_t QUERY_FIELD_COUNT = 4;
+
+struct ColumnInfo {
+    uint32_t value_count;    // distinct values
+    uint32_t row_count;      // codes: one per package, or one per dependency
+    uint64_t rows_offset;    // 0 for single-valued columns
+    uint64_t codes_offset;
+    uint64_t values_offset;  // the value offset table; the blob follows it
+    uint64_t values_size;
+};
+
+struct ColumnsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    ColumnInfo columns[QUERY_FIELD_COUNT];  // indexed by QueryField
+};
+
+// One step of a compiled query, in postfix order: a term pushes the bitmap
+// of the packages it matches, an operator pops its operands and pushes the
+// result.
+struct QueryOp {
+    enum Kind { Field, Text, And, Or, Not } kind = Field;
+    QueryField field = QueryField::None;  // Field only
+    std::string value = {};               // Field and Text
+    bool prefix = false;                  // Field only: value ended in '*'
+};
+
+struct Query {
+    std::vector<QueryOp> program;
+};
+
+// Serialize the columns of packages (in id order); dependency strings are
+// looked up in repo.dependencies and reduced to their package names.
+std::string build_column_index(const RepoRecords& repo, const std::vector<const RepoRecord*>& packages);
+
+// Whether query has a field:value term naming one of the fields above, and
+// so is parsed as a query (where AND, OR and NOT are operators). Anything
+// else, "http://mirror" or "rock AND roll" included, is a plain search.
+bool is_structured_query(std::string_view query);
+
+// Compile query into out. On a syntax error returns false and describes it
+// in error.
+bool parse_query(std::string_view query, Query& out, std::string& error);
+
+// Ids, in name order, of the packages matching query. Returns false if the
+// column index or the text table cannot be read.
+bool run_query(const RepoIndex& index, const Query& query, std::vector<uint32_t>& matches);
@@ -0,0 +1,370 @@
+#include "repo_resolve.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "repo_sat.hpp"
+
+namespace {
+
+enum : uint8_t { UNSEEN, ACTIVE, DONE };
+
+// Deletion attempts spent shrinking an explanation; cores are small and this
+// only bounds pathological ones.
+constexpr std::size_t MAX_MINIMIZE_STEPS = 64;
+
+struct Frame {
+    uint32_t package;
+    uint32_t next_rule;
+};
+
+// A clause of the encoding and where it came from, for explanations.
+struct Rule {
+    enum Kind : uint8_t { Request, Depends, Conflicts, ConflictsInstalled, InstalledConflicts };
+    Kind kind;
+    uint32_t package;  // index id of the package the rule is about
+    uint32_t first;    // its first dependency record behind the rule
+    uint32_t count;    // Depends: the alternatives in the group
+    uint32_t other;    // InstalledConflicts: the installed package
+    std::vector<SatLiteral> clause;  // Depends: the package, then its candidates in order
+};
+
+struct Universe {
+    std::vector<uint32_t> packages;                    // variable -> index id
+    std::unordered_map<uint32_t, uint32_t> variables;  // index id -> variable
+    std::vector<bool> preferred;
+    std::vector<Rule> rules;
+    std::vector<std::vector<uint32_t>> rules_of;  // variable -> the rules about it
+};
+
+class Resolver {
+public:
+    Resolver(const RepoIndex& index, const std::function<bool(const DependencyView&)>& installed,
+             const std::vector<uint32_t>& installed_ids)
+        : index_(index), installed_(installed), installed_ids_(installed_ids) {}
+
+    void run(const std::vector<uint32_t>& requested, InstallPlan& plan) {
+        std::vector<uint32_t> roots;
+        for (uint32_t id : requested) {
+            if (id < index_.size() && std::find(roots.begin(), roots.end(), id) == roots.end()) roots.push_back(id);
+        }
+        build(roots);
+
+        SatSolver solver;
+        for (uint32_t v = 0; v < u_.packages.size(); ++v) solver.add_variable(u_.preferred[v]);
+        for (const Rule& rule : u_.rules) {
+            if (rule.kind != Rule::Request) solver.add_clause(rule.clause);
+        }
+
+        // Requests that propagation alone rules out fail on their own.
+        std::vector<uint32_t> remaining;
+        for (uint32_t root : roots) {
+            if (solver.fixed_false(sat_literal(u_.variables[root], true))) {
+                plan.problems.push_back(explain(root, {root}));
+            } else {
+                remaining.push_back(root);
+            }
+        }
+        roots.swap(remaining);
+
+        // Requests are assumptions, so one that fails can be dropped and the
+        // rest solved again without losing what the solver learned.
+        while (true) {
+            std::vector<SatLiteral> assumptions;
+            for (uint32_t root : roots) assumptions.push_back(sat_literal(u_.variables[root], true));
+            if (solver.solve(assumptions)) break;
+            std::vector<uint32_t> failed;
+            for (SatLiteral l : solver.failed_assumptions()) failed.push_back(u_.packages[sat_variable(l)]);
+            if (failed.empty()) {
+                // Cannot happen: without requests, installing nothing is a model.
+                for (uint32_t root : roots) plan.problems.push_back({std::string(index_.name(root)), "no solution", {}});
+                return;
+            }
+            // Blame a request that fails on its own; otherwise the last of
+            // the requests that cannot be installed together.
+            uint32_t culprit = UINT32_MAX;
+            for (uint32_t root : roots) {
+                if (std::find(failed.begin(), failed.end(), root) == failed.end()) continue;
+                culprit = root;
+                if (failed.size() == 1 || !solver.solve({sat_literal(u_.variables[root], true)})) {
+                    failed.assign(1, root);
+                    break;
+                }
+            }
+            plan.problems.push_back(explain(culprit, failed));
+            roots.erase(std::find(roots.begin(), roots.end(), culprit));
+            solver.reset_phases();  // the failed attempts leave no taste behind
+        }
+        order(solver, roots, plan);
+    }
+
+private:
+    uint32_t variable(uint32_t id, std::vector<uint32_t>& queue) {
+        auto [it, inserted] = u_.variables.emplace(id, static_cast<uint32_t>(u_.packages.size()));
+        if (inserted) {
+            u_.packages.push_back(id);
+            u_.preferred.push_back(false);
+            u_.rules_of.emplace_back();
+            queue.push_back(id);
+        }
+        return it->second;
+    }
+
+    void add_rule(Rule rule) {
+        u_.rules_of[sat_variable(rule.clause[0])].push_back(static_cast<uint32_t>(u_.rules.size()));
+        u_.rules.push_back(std::move(rule));
+    }
+
+    // Every package the requests can reach through a dependency not yet met,
+    // and the rules over them.
+    void build(const std::vector<uint32_t>& roots) {
+        std::vector<uint32_t> queue;
+        for (uint32_t root : roots) {
+            uint32_t v = variable(root, queue);
+            u_.preferred[v] = true;
+            add_rule({Rule::Request, root, 0, 0, 0, {sat_literal(v, true)}});
+        }
+        for (std::size_t next = 0; next < queue.size(); ++next) {
+            uint32_t id = queue[next];
+            uint32_t v = u_.variables[id];
+            PackageView pkg = index_.package(id);
+            uint32_t d = 0;
+            while (d < pkg.deps_count) {
+                uint32_t first = d;
+                DependencyView dep = index_.dependency(pkg, d++);
+                if (dep.conflict() || dep.provides()) continue;
+                while (d < pkg.deps_count && index_.dependency(pkg, d).alternative()) ++d;
+                add_depends(id, v, pkg, first, d - first, queue);
+            }
+        }
+        for (uint32_t v = 0; v < u_.packages.size(); ++v) add_conflicts(u_.packages[v], v);
+        for (uint32_t id : installed_ids_) {
+            if (id >= index_.size()) continue;
+            PackageView pkg = index_.package(id);
+            for (uint32_t d = 0; d < pkg.deps_count; ++d) {
+                DependencyView dep = index_.dependency(pkg, d);
+                if (!dep.conflict() || dep.package == id) continue;
+                auto target = u_.variables.find(dep.package);
+                if (target == u_.variables.end() || !dep.satisfied_by(index_.package(dep.package).version_key)) continue;
+                add_rule({Rule::InstalledConflicts, dep.package, d, 1, id, {sat_literal(target->second, false)}});
+            }
+            auto it = u_.variables.find(id);
+            if (it != u_.variables.end()) u_.preferred[it->second] = true;
+        }
+    }
+
+    void add_depends(uint32_t id, uint32_t v, const PackageView& pkg, uint32_t first, uint32_t count,
+                     std::vector<uint32_t>& queue) {
+        Rule rule{Rule::Depends, id, first, count, 0, {sat_literal(v, false)}};
+        for (uint32_t a = first; a < first + count; ++a) {
+            DependencyView dep = index_.dependency(pkg, a);
+            if (installed_(dep)) return;
+            if (dep.package == REPO_INDEX_NPOS || !dep.satisfied_by(index_.package(dep.package).version_key)) continue;
+            if (dep.package == id) return;  // the package meets it itself
+        }
+        for (uint32_t a = first; a < first + count; ++a) {
+            DependencyView dep = index_.dependency(pkg, a);
+            if (dep.package == REPO_INDEX_NPOS || !dep.satisfied_by(index_.package(dep.package).version_key)) continue;
+            rule.clause.push_back(sat_literal(variable(dep.package, queue), true));
+        }
+        // Where there is a choice, try the first alternative first. A sole
+        // candidate needs no preference: propagation installs it when needed.
+        if (rule.clause.size() > 2) u_.preferred[sat_variable(rule.clause[1])] = true;
+        add_rule(std::move(rule));
+    }
+
+    void add_conflicts(uint32_t id, uint32_t v) {
+        PackageView pkg = index_.package(id);
+        for (uint32_t d = 0; d < pkg.deps_count; ++d) {
+            DependencyView dep = index_.dependency(pkg, d);
+            if (!dep.conflict() || dep.package == id) continue;
+            if (installed_(dep)) {
+                add_rule({Rule::ConflictsInstalled, id, d, 1, 0, {sat_literal(v, false)}});
+            }
+            auto target = u_.variables.find(dep.package);
+            if (target != u_.variables.end() && dep.satisfied_by(index_.package(dep.package).version_key)) {
+                add_rule({Rule::Conflicts, id, d, 1, 0, {sat_literal(v, false), sat_literal(target->second, false)}});
+            }
+        }
+    }
+
+    std::string describe(const Rule& rule) const {
+        PackageView pkg = index_.package(rule.package);
+        std::string name(pkg.name);
+        switch (rule.kind) {
+            case Rule::Request:
+                return name + " was requested";
+            case Rule::Conflicts:
+                return name + " conflicts with " + std::string(index_.dependency(pkg, rule.first).raw);
+            case Rule::ConflictsInstalled:
+                return name + " conflicts with " + std::string(index_.dependency(pkg, rule.first).raw) + ", which is installed";
+            case Rule::InstalledConflicts: {
+                PackageView other = index_.package(rule.other);
+                return "installed " + std::string(other.name) + " conflicts with " +
+                       std::string(index_.dependency(other, rule.first).raw);
+            }
+            case Rule::Depends:
+                break;
+        }
+        std::string text;
+        for (uint32_t a = rule.first; a < rule.first + rule.count; ++a) {
+            text += (a > rule.first ? " | " : "") + std::string(index_.dependency(pkg, a).raw);
+        }
+        std::string line = name + " needs " + text;
+        if (rule.clause.size() > 1) return line;
+        if (rule.count > 1) return line + ", but no available package meets it";
+        DependencyView dep = index_.dependency(pkg, rule.first);
+        if (dep.package == REPO_INDEX_NPOS) return line + ", which no repository provides";
+        PackageView target = index_.package(dep.package);
+        return line + ", but only " + std::string(target.name) + " " + std::string(target.version) + " is available";
+    }
+
+    // A minimal set of rules that rule out installing the requests in roots
+    // together: a fresh solver guards every rule they can reach with a
+    // selector variable, takes the selectors that fail together and drops
+    // them one at a time while the rest still fail.
+    ResolveProblem explain(uint32_t culprit, const std::vector<uint32_t>& roots) {
+        // Number the reachable packages afresh so the solver stays small.
+        SatSolver solver;
+        local_.resize(u_.packages.size(), UINT32_MAX);
+        std::vector<uint32_t> queue;
+        auto reach = [&](uint32_t v) {
+            if (local_[v] != UINT32_MAX) return;
+            local_[v] = solver.add_variable(u_.preferred[v]);
+            queue.push_back(v);
+        };
+        for (uint32_t root : roots) reach(u_.variables[root]);
+        for (std::size_t next = 0; next < queue.size(); ++next) {
+            for (uint32_t r : u_.rules_of[queue[next]]) {
+                const Rule& rule = u_.rules[r];
+                if (rule.kind != Rule::Depends) continue;
+                for (std::size_t i = 1; i < rule.clause.size(); ++i) reach(sat_variable(rule.clause[i]));
+            }
+        }
+
+        std::unordered_map<SatLiteral, uint32_t> rule_of;
+        std::vector<SatLiteral> selectors;
+        for (uint32_t v : queue) {
+            for (uint32_t r : u_.rules_of[v]) {
+                const Rule& rule = u_.rules[r];
+                if (rule.kind == Rule::Request && std::find(roots.begin(), roots.end(), rule.package) == roots.end()) continue;
+                std::vector<SatLiteral> clause;
+                for (SatLiteral l : rule.clause) {
+                    if (local_[sat_variable(l)] == UINT32_MAX) break;  // the rule holds outside what roots reach
+                    clause.push_back(sat_literal(local_[sat_variable(l)], !(l & 1)));
+                }
+                if (clause.size() < rule.clause.size()) continue;
+                SatLiteral selector = sat_literal(solver.add_variable(true), true);
+                clause.push_back(selector ^ 1);
+                solver.add_clause(std::move(clause));
+                rule_of[selector] = r;
+                selectors.push_back(selector);
+            }
+        }
+
+        for (uint32_t v : queue) local_[v] = UINT32_MAX;
+
+        std::vector<SatLiteral> core;
+        if (!solver.solve(selectors)) core = solver.failed_assumptions();
+        std::size_t steps = 0;
+        for (std::size_t i = 0; i < core.size() && steps < MAX_MINIMIZE_STEPS; ++steps) {
+            std::vector<SatLiteral> trial = core;
+            trial.erase(trial.begin() + i);
+            if (solver.solve(trial)) {
+                ++i;  // needed
+            } else {
+                std::unordered_set<SatLiteral> kept(solver.failed_assumptions().begin(), solver.failed_assumptions().end());
+                trial.erase(std::remove_if(trial.begin(), trial.end(), [&](SatLiteral s) { return !kept.count(s); }),
+                            trial.end());
+                core = std::move(trial);
+            }
+        }
+        std::vector<uint32_t> rules;
+        for (SatLiteral s : core) rules.push_back(rule_of[s]);
+        std::sort(rules.begin(), rules.end());
+
+        ResolveProblem problem{std::string(index_.name(culprit)), {}, {}};
+        const Rule* main = nullptr;
+        std::vector<std::string> others;
+        for (uint32_t r : rules) {
+            const Rule& rule = u_.rules[r];
+            problem.explanation.push_back(describe(rule));
+            bool dead_end = rule.clause.size() == 1 && rule.kind != Rule::Request;
+            if (dead_end || (rule.kind == Rule::Conflicts && (!main || main->clause.size() > 1))) main = &rule;
+            if (rule.kind == Rule::Request && rule.package != culprit) others.push_back(std::string(index_.name(rule.package)));
+        }
+        if (main) {
+            problem.message = describe(*main);
+        } else if (!others.empty()) {
+            problem.message = "it cannot be installed together with ";
+            for (std::size_t i = 0; i < others.size(); ++i) problem.message += (i ? ", " : "") + others[i];
+        } else {
+            problem.message = "its dependencies cannot all be met";
+        }
+        return problem;
+    }
+
+    // Plan the packages reachable from roots through the first alternative
+    // the model installs, dependencies first.
+    void order(const SatSolver& solver, const std::vector<uint32_t>& roots, InstallPlan& plan) {
+        std::vector<uint8_t> state(u_.packages.size(), UNSEEN);
+        std::vector<Frame> stack;
+        // The dependency rule i of v leads to its first installed
+        // alternative; other rules lead nowhere (back to v).
+        auto chosen = [&](uint32_t v, uint32_t i) {
+            const Rule& rule = u_.rules[u_.rules_of[v][i]];
+            if (rule.kind != Rule::Depends) return v;
+            for (std::size_t k = 1; k < rule.clause.size(); ++k) {
+                if (solver.value(sat_variable(rule.clause[k]))) return sat_variable(rule.clause[k]);
+            }
+            return v;  // unreachable in a model
+        };
+        for (uint32_t root : roots) {
+            uint32_t rv = u_.variables[root];
+            if (state[rv] != UNSEEN) continue;
+            state[rv] = ACTIVE;
+            stack.push_back({rv, 0});
+            while (!stack.empty()) {
+                Frame& top = stack.back();
+                if (top.next_rule == u_.rules_of[top.package].size()) {
+                    state[top.package] = DONE;
+                    plan.packages.push_back(u_.packages[top.package]);
+                    stack.pop_back();
+                    continue;
+                }
+                uint32_t target = chosen(top.package, top.next_rule++);
+                if (target == top.package || state[target] == DONE) continue;
+                if (state[target] == ACTIVE) {
+                    // The target is an ancestor on the stack: the frames from
+                    // it up to here form a cycle.
+                    std::vector<uint32_t> cycle;
+                    bool inside = false;
+                    for (const Frame& f : stack) {
+                        inside = inside || f.package == target;
+                        if (inside) cycle.push_back(u_.packages[f.package]);
+                    }
+                    plan.cycles.push_back(std::move(cycle));
+                    continue;
+                }
+                state[target] = ACTIVE;
+                stack.push_back({target, 0});
+            }
+        }
+    }
+
+    const RepoIndex& index_;
+    const std::function<bool(const DependencyView&)>& installed_;
+    const std::vector<uint32_t>& installed_ids_;
+    Universe u_;
+    std::vector<uint32_t> local_;  // explain(): variable -> its number there
+};
+
+} // namespace
+
+void resolve_install(const RepoIndex& index, const std::vector<uint32_t>& requested,
+                     const std::function<bool(const DependencyView&)>& installed,
+                     const std::vector<uint32_t>& installed_ids, InstallPlan& plan) {
+    plan = InstallPlan();
+    Resolver(index, installed, installed_ids).run(requested, plan);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "repo_index.hpp"
+
+// Install planning.
+//
+// Given the packages a user asked for, the resolver collects every package
+// their dependencies could pull in (each DepRecord already names its target
+// package) and hands the choice to a SAT solver (repo_sat.hpp), one variable
+// per package:
+//
+//   - a requested package must be installed;
+//   - a package needs one of the alternatives of each dependency that no
+//     installed package already meets, among those whose version in the
+//     index meets the constraint ("mta | sendmail>=8" is two alternatives),
+//     and every package that provides an unversioned alternative's name is
+//     one more (the index lists them as DEP_PROVIDER records);
+//   - two packages where one conflicts with the other cannot both be
+//     installed, and neither can a package that conflicts with an installed
+//     one or that an installed package conflicts with.
+//
+// The index carries one version per package, so there is no choice between
+// versions; the solver chooses between alternatives and finds out whether
+// conflicts can be avoided. It first tries the first alternative of every
+// dependency and keeps installed packages, so the common case is decided
+// without a single conflict. Only packages reachable from the requested ones
+// through the chosen alternatives are planned, every package after all of
+// its dependencies, ready to be installed front to back. A dependency cycle
+// cannot be ordered; it is reported and its packages are installed in the
+// order the search finished them.
+//
+// A requested package that cannot be installed, on its own or together with
+// the others, is left out and the rest is planned without it. Its problem
+// carries an explanation: a minimal set of the rules above that cannot all
+// hold.
+
+struct ResolveProblem {
+    std::string package;                   // the requested package that cannot be installed
+    std::string message;                   // the main reason, in one line
+    std::vector<std::string> explanation;  // rules that cannot all hold
+};
+
+struct InstallPlan {
+    std::vector<uint32_t> packages;  // dependencies first
+    std::vector<std::vector<uint32_t>> cycles;
+    std::vector<ResolveProblem> problems;
+};
+
+// installed(dep) tells whether an installed package already meets dep;
+// installed_ids are the index ids of installed packages, whose conflicts
+// are honored and which the solver prefers to keep.
+void resolve_install(const RepoIndex& index, const std::vector<uint32_t>& requested,
+                     const std::function<bool(const DependencyView&)>& installed,
+                     const std::vector<uint32_t>& installed_ids, InstallPlan& plan);
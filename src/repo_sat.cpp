@@ -0,0 +1,339 @@
+#include "repo_sat.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint8_t FALSE = 0;
+constexpr uint8_t TRUE = 1;
+constexpr uint8_t UNASSIGNED = 2;
+constexpr uint32_t NO_REASON = UINT32_MAX;
+constexpr uint32_t NO_CONFLICT = UINT32_MAX;
+constexpr SatLiteral NO_LITERAL = UINT32_MAX;
+constexpr uint32_t NOT_IN_HEAP = UINT32_MAX;
+constexpr double ACTIVITY_DECAY = 0.95;
+
+// 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, 1, 1, 2, 4, 8, ...
+uint64_t luby(uint64_t i) {
+    uint64_t size = 1;
+    uint64_t exponent = 0;
+    while (size < i + 1) {
+        size = 2 * size + 1;
+        ++exponent;
+    }
+    while (size - 1 != i) {
+        size = (size - 1) / 2;
+        --exponent;
+        i %= size;
+    }
+    return uint64_t(1) << exponent;
+}
+
+} // namespace
+
+uint32_t SatSolver::add_variable(bool preferred) {
+    uint32_t v = variables();
+    assigns_.push_back(UNASSIGNED);
+    phase_.push_back(preferred);
+    preferred_.push_back(preferred);
+    levels_.push_back(0);
+    reasons_.push_back(NO_REASON);
+    activity_.push_back(0.0);
+    seen_.push_back(0);
+    watches_.emplace_back();
+    watches_.emplace_back();
+    heap_position_.push_back(NOT_IN_HEAP);
+    heap_insert(v);
+    return v;
+}
+
+uint8_t SatSolver::literal_value(SatLiteral literal) const {
+    uint8_t v = assigns_[sat_variable(literal)];
+    return v == UNASSIGNED ? UNASSIGNED : v ^ (literal & 1);
+}
+
+void SatSolver::enqueue(SatLiteral literal, uint32_t reason) {
+    uint32_t v = sat_variable(literal);
+    assigns_[v] = (literal & 1) ? FALSE : TRUE;
+    levels_[v] = decision_level();
+    reasons_[v] = reason;
+    trail_.push_back(literal);
+}
+
+uint32_t SatSolver::attach(std::vector<SatLiteral> clause) {
+    uint32_t index = static_cast<uint32_t>(clauses_.size());
+    watches_[clause[0] ^ 1].push_back(index);
+    watches_[clause[1] ^ 1].push_back(index);
+    clauses_.push_back(std::move(clause));
+    return index;
+}
+
+void SatSolver::add_clause(std::vector<SatLiteral> clause) {
+    if (!ok_) return;
+    std::sort(clause.begin(), clause.end());
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < clause.size(); ++i) {
+        SatLiteral l = clause[i];
+        if (literal_value(l) == TRUE || (i + 1 < clause.size() && clause[i + 1] == (l ^ 1))) return;  // already met
+        if (literal_value(l) == FALSE || (kept > 0 && clause[kept - 1] == l)) continue;
+        clause[kept++] = l;
+    }
+    clause.resize(kept);
+    if (clause.empty()) {
+        ok_ = false;
+    } else if (clause.size() == 1) {
+        enqueue(clause[0], NO_REASON);
+        ok_ = propagate() == NO_CONFLICT;
+    } else {
+        attach(std::move(clause));
+    }
+}
+
+uint32_t SatSolver::propagate() {
+    uint32_t conflict = NO_CONFLICT;
+    while (propagated_ < trail_.size() && conflict == NO_CONFLICT) {
+        SatLiteral p = trail_[propagated_++];
+        SatLiteral false_literal = p ^ 1;
+        std::vector<uint32_t>& watching = watches_[p];
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < watching.size()) {
+            uint32_t index = watching[i++];
+            std::vector<SatLiteral>& c = clauses_[index];
+            if (c[0] == false_literal) std::swap(c[0], c[1]);
+            if (literal_value(c[0]) == TRUE) {
+                watching[j++] = index;
+                continue;
+            }
+            bool moved = false;
+            for (std::size_t k = 2; k < c.size(); ++k) {
+                if (literal_value(c[k]) != FALSE) {
+                    std::swap(c[1], c[k]);
+                    watches_[c[1] ^ 1].push_back(index);
+                    moved = true;
+                    break;
+                }
+            }
+            if (moved) continue;
+            watching[j++] = index;
+            if (literal_value(c[0]) == FALSE) {
+                conflict = index;
+                while (i < watching.size()) watching[j++] = watching[i++];
+            } else {
+                enqueue(c[0], index);
+            }
+        }
+        watching.resize(j);
+    }
+    return conflict;
+}
+
+void SatSolver::bump(uint32_t variable) {
+    activity_[variable] += activity_step_;
+    if (activity_[variable] > 1e100) {
+        for (double& a : activity_) a *= 1e-100;
+        activity_step_ *= 1e-100;
+    }
+    if (heap_position_[variable] != NOT_IN_HEAP) heap_up(heap_position_[variable]);
+}
+
+// First-UIP learning: resolve the conflict clause with the reasons of
+// literals from the current level until only one of them is left.
+void SatSolver::analyze(uint32_t conflict, std::vector<SatLiteral>& learnt, uint32_t& backtrack_level) {
+    learnt.assign(1, 0);
+    uint32_t pending = 0;
+    bool first = true;
+    SatLiteral p = 0;
+    std::size_t index = trail_.size();
+    uint32_t clause = conflict;
+    do {
+        const std::vector<SatLiteral>& c = clauses_[clause];
+        for (std::size_t k = first ? 0 : 1; k < c.size(); ++k) {
+            uint32_t v = sat_variable(c[k]);
+            if (seen_[v] || levels_[v] == 0) continue;
+            seen_[v] = 1;
+            bump(v);
+            if (levels_[v] >= decision_level()) {
+                ++pending;
+            } else {
+                learnt.push_back(c[k]);
+            }
+        }
+        first = false;
+        while (!seen_[sat_variable(trail_[--index])]) {}
+        p = trail_[index];
+        clause = reasons_[sat_variable(p)];
+        seen_[sat_variable(p)] = 0;
+        --pending;
+    } while (pending > 0);
+    learnt[0] = p ^ 1;
+
+    backtrack_level = 0;
+    std::size_t highest = 1;
+    for (std::size_t i = 1; i < learnt.size(); ++i) {
+        uint32_t level = levels_[sat_variable(learnt[i])];
+        if (level > backtrack_level) {
+            backtrack_level = level;
+            highest = i;
+        }
+    }
+    if (learnt.size() > 1) std::swap(learnt[1], learnt[highest]);
+    for (SatLiteral l : learnt) seen_[sat_variable(l)] = 0;
+}
+
+// literal is true and contradicts an assumption: collect the assumptions
+// it was derived from.
+void SatSolver::analyze_final(SatLiteral literal) {
+    failed_.assign(1, literal ^ 1);
+    if (decision_level() == 0) return;
+    seen_[sat_variable(literal)] = 1;
+    for (std::size_t i = trail_.size(); i-- > trail_limits_[0];) {
+        uint32_t v = sat_variable(trail_[i]);
+        if (!seen_[v]) continue;
+        if (reasons_[v] == NO_REASON) {
+            failed_.push_back(trail_[i]);
+        } else {
+            const std::vector<SatLiteral>& c = clauses_[reasons_[v]];
+            for (std::size_t k = 1; k < c.size(); ++k) {
+                if (levels_[sat_variable(c[k])] > 0) seen_[sat_variable(c[k])] = 1;
+            }
+        }
+        seen_[v] = 0;
+    }
+    seen_[sat_variable(literal)] = 0;
+}
+
+void SatSolver::cancel_until(uint32_t level) {
+    if (decision_level() <= level) return;
+    for (std::size_t i = trail_.size(); i-- > trail_limits_[level];) {
+        uint32_t v = sat_variable(trail_[i]);
+        phase_[v] = assigns_[v];
+        assigns_[v] = UNASSIGNED;
+        reasons_[v] = NO_REASON;
+        if (heap_position_[v] == NOT_IN_HEAP) heap_insert(v);
+    }
+    trail_.resize(trail_limits_[level]);
+    trail_limits_.resize(level);
+    propagated_ = trail_.size();
+}
+
+SatLiteral SatSolver::pick_branch() {
+    while (!heap_.empty()) {
+        uint32_t v = heap_pop();
+        if (assigns_[v] == UNASSIGNED) return sat_literal(v, phase_[v]);
+    }
+    return NO_LITERAL;
+}
+
+SatSolver::Search SatSolver::search(uint64_t conflict_budget) {
+    uint64_t conflicts = 0;
+    std::vector<SatLiteral> learnt;
+    while (true) {
+        uint32_t conflict = propagate();
+        if (conflict != NO_CONFLICT) {
+            ++conflicts_;
+            ++conflicts;
+            if (decision_level() == 0) return Search::Unsat;
+            uint32_t backtrack_level = 0;
+            analyze(conflict, learnt, backtrack_level);
+            cancel_until(backtrack_level);
+            if (learnt.size() == 1) {
+                enqueue(learnt[0], NO_REASON);
+            } else {
+                SatLiteral asserting = learnt[0];
+                enqueue(asserting, attach(learnt));
+            }
+            activity_step_ /= ACTIVITY_DECAY;
+            continue;
+        }
+        if (conflicts >= conflict_budget) {
+            cancel_until(0);
+            return Search::Restart;
+        }
+        SatLiteral next = NO_LITERAL;
+        while (decision_level() < assumptions_.size()) {
+            SatLiteral a = assumptions_[decision_level()];
+            if (literal_value(a) == TRUE) {
+                trail_limits_.push_back(static_cast<uint32_t>(trail_.size()));  // nothing to decide
+            } else if (literal_value(a) == FALSE) {
+                analyze_final(a ^ 1);
+                return Search::Unsat;
+            } else {
+                next = a;
+                break;
+            }
+        }
+        if (next == NO_LITERAL) {
+            next = pick_branch();
+            if (next == NO_LITERAL) return Search::Sat;
+        }
+        trail_limits_.push_back(static_cast<uint32_t>(trail_.size()));
+        enqueue(next, NO_REASON);
+    }
+}
+
+bool SatSolver::solve(const std::vector<SatLiteral>& assumptions) {
+    model_.clear();
+    failed_.clear();
+    if (!ok_) return false;
+    assumptions_ = assumptions;
+    Search result = Search::Restart;
+    for (uint64_t restart = 0; result == Search::Restart; ++restart) {
+        result = search(luby(restart) * SAT_RESTART_BASE);
+    }
+    if (result == Search::Sat) {
+        model_.resize(variables());
+        for (uint32_t v = 0; v < variables(); ++v) model_[v] = assigns_[v] == TRUE;
+    } else if (failed_.empty()) {
+        ok_ = false;
+    }
+    cancel_until(0);
+    return result == Search::Sat;
+}
+
+void SatSolver::heap_insert(uint32_t variable) {
+    heap_position_[variable] = static_cast<uint32_t>(heap_.size());
+    heap_.push_back(variable);
+    heap_up(heap_position_[variable]);
+}
+
+void SatSolver::heap_up(uint32_t position) {
+    uint32_t v = heap_[position];
+    while (position > 0) {
+        uint32_t parent = (position - 1) / 2;
+        if (activity_[heap_[parent]] >= activity_[v]) break;
+        heap_[position] = heap_[parent];
+        heap_position_[heap_[position]] = position;
+        position = parent;
+    }
+    heap_[position] = v;
+    heap_position_[v] = position;
+}
+
+void SatSolver::heap_down(uint32_t position) {
+    uint32_t v = heap_[position];
+    uint32_t size = static_cast<uint32_t>(heap_.size());
+    while (2 * position + 1 < size) {
+        uint32_t child = 2 * position + 1;
+        if (child + 1 < size && activity_[heap_[child + 1]] > activity_[heap_[child]]) ++child;
+        if (activity_[heap_[child]] <= activity_[v]) break;
+        heap_[position] = heap_[child];
+        heap_position_[heap_[position]] = position;
+        position = child;
+    }
+    heap_[position] = v;
+    heap_position_[v] = position;
+}
+
+uint32_t SatSolver::heap_pop() {
+    uint32_t top = heap_[0];
+    heap_position_[top] = NOT_IN_HEAP;
+    uint32_t last = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) {
+        heap_[0] = last;
+        heap_position_[last] = 0;
+        heap_down(0);
+    }
+    return top;
+}
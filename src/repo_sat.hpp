@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A small CDCL SAT solver for install planning.
+//
+// Variables are numbered from 0; a literal is 2 * variable, plus 1 when
+// negated. The solver follows the MiniSat design: two watched literals per
+// clause for unit propagation, first-UIP conflict analysis with clause
+// learning, VSIDS branching, restarts on the Luby sequence (in units of
+// SAT_RESTART_BASE conflicts) and phase saving. Each variable starts out in
+// the phase it was created with, so a caller can steer the first model
+// towards the assignment it would rather have.
+//
+// solve() takes assumptions, literals that must hold for this call only.
+// When it fails, failed_assumptions() names a subset of them that cannot
+// hold together; clauses learned along the way are kept for the next call.
+// Learned clauses are never deleted: dependency problems are small and
+// rarely need more than a handful of conflicts.
+
+using SatLiteral = uint32_t;
+
+constexpr uint32_t SAT_RESTART_BASE = 100;
+
+inline SatLiteral sat_literal(uint32_t variable, bool value) { return 2 * variable + (value ? 0 : 1); }
+inline uint32_t sat_variable(SatLiteral literal) { return literal >> 1; }
+
+class SatSolver {
+public:
+    // A new variable whose first decision will be preferred.
+    uint32_t add_variable(bool preferred);
+    // Add a clause over existing variables. Only between solve() calls.
+    void add_clause(std::vector<SatLiteral> clause);
+    // Go back to the preferred phases, forgetting the saved ones.
+    void reset_phases() { phase_ = preferred_; }
+    // Whether the clauses and the assumptions can all hold.
+    bool solve(const std::vector<SatLiteral>& assumptions = {});
+
+    // After a successful solve(): the value of variable in the model.
+    bool value(uint32_t variable) const { return model_[variable]; }
+    // After a failed solve(): assumptions that cannot hold together. Empty
+    // when the clauses are unsatisfiable on their own.
+    const std::vector<SatLiteral>& failed_assumptions() const { return failed_; }
+
+    // Whether the clauses (and what was learned from them) already force
+    // literal false, before any decision.
+    bool fixed_false(SatLiteral literal) const {
+        return !ok_ || (levels_[sat_variable(literal)] == 0 && literal_value(literal) == 0);
+    }
+
+    uint32_t variables() const { return static_cast<uint32_t>(assigns_.size()); }
+    uint64_t conflicts() const { return conflicts_; }
+
+private:
+    enum class Search { Sat, Unsat, Restart };
+
+    uint8_t literal_value(SatLiteral literal) const;
+    void enqueue(SatLiteral literal, uint32_t reason);
+    uint32_t propagate();
+    void analyze(uint32_t conflict, std::vector<SatLiteral>& learnt, uint32_t& backtrack_level);
+    void analyze_final(SatLiteral literal);
+    void cancel_until(uint32_t level);
+    uint32_t decision_level() const { return static_cast<uint32_t>(trail_limits_.size()); }
+    uint32_t attach(std::vector<SatLiteral> clause);
+    Search search(uint64_t conflict_budget);
+    SatLiteral pick_branch();
+    void bump(uint32_t variable);
+
+    void heap_insert(uint32_t variable);
+    void heap_up(uint32_t position);
+    void heap_down(uint32_t position);
+    uint32_t heap_pop();
+
+    std::vector<std::vector<SatLiteral>> clauses_;
+    std::vector<std::vector<uint32_t>> watches_;  // by literal: clauses watching its negation
+    std::vector<uint8_t> assigns_;                // 0 false, 1 true, 2 unassigned
+    std::vector<uint8_t> phase_;
+    std::vector<uint8_t> preferred_;
+    std::vector<uint32_t> levels_;
+    std::vector<uint32_t> reasons_;
+    std::vector<double> activity_;
+    std::vector<uint8_t> seen_;
+    std::vector<SatLiteral> trail_;
+    std::vector<uint32_t> trail_limits_;
+    std::size_t propagated_ = 0;
+    std::vector<uint32_t> heap_;
+    std::vector<uint32_t> heap_position_;
+    double activity_step_ = 1.0;
+    std::vector<SatLiteral> assumptions_;
+    std::vector<bool> model_;
+    std::vector<SatLiteral> failed_;
+    uint64_t conflicts_ = 0;
+    bool ok_ = true;
+};
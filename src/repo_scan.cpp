@@ -0,0 +1,560 @@
+#include "repo_scan.hpp"
+
+#include <charconv>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FOX_SCAN_X86 1
+#endif
+
+namespace {
+
+// Per-block classification: bit i describes byte i of a 64-byte block.
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+};
+
+// Bit i of the result is the xor of bits 0..i of x. Applied to the quote mask
+// this marks every byte from an opening quote up to its closing quote.
+inline uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+BlockMasks classify_scalar(const char* p) {
+    BlockMasks m{0, 0, 0};
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        switch (p[i]) {
+            case '"': m.quote |= bit; break;
+            case '\\': m.backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+            default: break;
+        }
+    }
+    return m;
+}
+
+#ifdef FOX_SCAN_X86
+// '[' and '{' (and ']' and '}') differ only in bit 0x20, so folding that bit
+// in lets four compares cover all six structural characters.
+inline uint32_t sse2_mask16(__m128i v, __m128i c) {
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, c)));
+}
+
+BlockMasks classify_sse2(const char* p) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i fold = _mm_set1_epi8(0x20);
+    BlockMasks m{0, 0, 0};
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        __m128i folded = _mm_or_si128(v, fold);
+        uint64_t q = sse2_mask16(v, quote);
+        uint64_t b = sse2_mask16(v, backslash);
+        uint64_t o = sse2_mask16(folded, open) | sse2_mask16(folded, close) |
+                     sse2_mask16(v, colon) | sse2_mask16(v, comma);
+        m.quote |= q << (16 * i);
+        m.backslash |= b << (16 * i);
+        m.op |= o << (16 * i);
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+inline uint32_t avx2_mask32(__m256i v, __m256i c) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c)));
+}
+
+__attribute__((target("avx2")))
+BlockMasks classify_avx2(const char* p) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    __m256i lo_folded = _mm256_or_si256(lo, fold);
+    __m256i hi_folded = _mm256_or_si256(hi, fold);
+    BlockMasks m;
+    m.quote = avx2_mask32(lo, quote) | uint64_t(avx2_mask32(hi, quote)) << 32;
+    m.backslash = avx2_mask32(lo, backslash) | uint64_t(avx2_mask32(hi, backslash)) << 32;
+    uint64_t op_lo = avx2_mask32(lo_folded, open) | avx2_mask32(lo_folded, close) |
+                     avx2_mask32(lo, colon) | avx2_mask32(lo, comma);
+    uint64_t op_hi = avx2_mask32(hi_folded, open) | avx2_mask32(hi_folded, close) |
+                     avx2_mask32(hi, colon) | avx2_mask32(hi, comma);
+    m.op = op_lo | op_hi << 32;
+    return m;
+}
+#endif
+
+using ClassifyFn = BlockMasks (*)(const char*);
+
+struct Kernel {
+    ClassifyFn classify;
+    const char* name;
+};
+
+Kernel select_kernel() {
+#ifdef FOX_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {classify_avx2, "avx2"};
+    return {classify_sse2, "sse2"};
+#else
+    return {classify_scalar, "scalar"};
+#endif
+}
+
+const Kernel& kernel() {
+    static const Kernel k = select_kernel();
+    return k;
+}
+
+template <ClassifyFn Classify>
+void find_structurals_with(const char* data, std::size_t size, std::vector<uint32_t>& out) {
+    uint64_t prev_in_string = 0;
+    bool escape_carry = false;
+    char tail[64];
+    for (std::size_t pos = 0; pos < size; pos += 64) {
+        const char* block = data + pos;
+        if (size - pos < 64) {
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, block, size - pos);
+            block = tail;
+        }
+        BlockMasks m = Classify(block);
+
+        // Backslashes are rare in package metadata, so runs of them are
+        // resolved with a plain loop instead of carry arithmetic.
+        uint64_t escaped = 0;
+        if (m.backslash || escape_carry) {
+            bool escape = escape_carry;
+            for (int i = 0; i < 64; ++i) {
+                if (escape) {
+                    escaped |= uint64_t(1) << i;
+                    escape = false;
+                } else if (m.backslash & (uint64_t(1) << i)) {
+                    escape = true;
+                }
+            }
+            escape_carry = escape;
+        }
+
+        uint64_t quotes = m.quote & ~escaped;
+        uint64_t in_string = prefix_xor(quotes) ^ prev_in_string;
+        prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+        uint64_t structurals = (m.op & ~in_string) | quotes;
+        while (structurals) {
+            out.push_back(static_cast<uint32_t>(pos + __builtin_ctzll(structurals)));
+            structurals &= structurals - 1;
+        }
+    }
+}
+
+inline bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Stage 2: recursive descent driven by the structural offsets. pos_ is the
+// byte offset of the next unread character and next_ the first structural
+// offset at or after it.
+class RecordParser {
+public:
+    RecordParser(std::string_view json, const std::vector<uint32_t>& structurals, RepoRecords& out)
+        : json_(json), idx_(structurals), out_(out) {}
+
+    bool parse() {
+        if (json_.size() >= 3 && std::memcmp(json_.data(), "\xEF\xBB\xBF", 3) == 0) pos_ = 3;
+        if (!parse_root()) return false;
+        skip_space();
+        if (pos_ != json_.size()) return fail("unexpected trailing characters");
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+
+private:
+    bool fail(const std::string& what) {
+        if (error_.empty()) error_ = "offset " + std::to_string(pos_) + ": " + what;
+        return false;
+    }
+
+    void skip_space() {
+        while (pos_ < json_.size() && is_space(json_[pos_])) ++pos_;
+    }
+
+    // Peek at the next significant character, or '\0' at end of input.
+    char peek() {
+        skip_space();
+        return pos_ < json_.size() ? json_[pos_] : '\0';
+    }
+
+    // Consume the structural character c at the current position.
+    bool expect(char c) {
+        if (peek() != c) return fail(std::string("expected '") + c + "'");
+        advance_structural();
+        return true;
+    }
+
+    // Move past the structural character at pos_, keeping next_ in sync.
+    void advance_structural() {
+        while (next_ < idx_.size() && idx_[next_] < pos_) ++next_;
+        ++next_;
+        ++pos_;
+    }
+
+    bool parse_string(std::string_view& value) {
+        if (peek() != '"') return fail("expected string");
+        while (next_ < idx_.size() && idx_[next_] < pos_) ++next_;
+        if (next_ + 1 >= idx_.size() || idx_[next_] != pos_) return fail("unterminated string");
+        std::size_t open = idx_[next_];
+        std::size_t close = idx_[next_ + 1];
+        next_ += 2;
+        pos_ = close + 1;
+        std::string_view raw = json_.substr(open + 1, close - open - 1);
+        for (char c : raw) {
+            if (static_cast<unsigned char>(c) < 0x20) return fail("control character in string");
+        }
+        if (raw.find('\\') == std::string_view::npos) {
+            value = raw;
+            return true;
+        }
+        scratch_.clear();
+        if (!decode_escapes(raw, scratch_)) return fail("invalid escape sequence");
+        value = out_.arena.store(scratch_);
+        return true;
+    }
+
+    static bool read_hex4(std::string_view s, std::size_t at, uint32_t& cp) {
+        if (at + 4 > s.size()) return false;
+        cp = 0;
+        for (std::size_t i = at; i < at + 4; ++i) {
+            char c = s[i];
+            cp <<= 4;
+            if (c >= '0' && c <= '9') cp |= c - '0';
+            else if (c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    static bool decode_escapes(std::string_view raw, std::string& out) {
+        out.reserve(raw.size());
+        for (std::size_t i = 0; i < raw.size(); ++i) {
+            char c = raw[i];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (++i >= raw.size()) return false;
+            switch (raw[i]) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!read_hex4(raw, i + 1, cp)) return false;
+                    i += 4;
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        uint32_t low;
+                        if (i + 2 >= raw.size() || raw[i + 1] != '\\' || raw[i + 2] != 'u' ||
+                            !read_hex4(raw, i + 3, low) || low < 0xDC00 || low > 0xDFFF) {
+                            return false;
+                        }
+                        i += 6;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                        return false;
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return true;
+    }
+
+    // Numbers, true, false and null never appear in the structural index;
+    // they run until the next delimiter and are validated here.
+    bool skip_scalar() {
+        std::size_t start = pos_;
+        while (pos_ < json_.size()) {
+            char c = json_[pos_];
+            if (is_space(c) || c == ',' || c == '}' || c == ']' || c == ':') break;
+            ++pos_;
+        }
+        std::string_view token = json_.substr(start, pos_ - start);
+        if (token == "true" || token == "false" || token == "null") return true;
+        if (!valid_number(token)) {
+            pos_ = start;
+            return fail("invalid literal");
+        }
+        return true;
+    }
+
+    static bool valid_number(std::string_view t) {
+        std::size_t i = 0;
+        auto digits = [&]() {
+            std::size_t begin = i;
+            while (i < t.size() && t[i] >= '0' && t[i] <= '9') ++i;
+            return i > begin;
+        };
+        if (i < t.size() && t[i] == '-') ++i;
+        if (i < t.size() && t[i] == '0') {
+            ++i;
+        } else if (!digits()) {
+            return false;
+        }
+        if (i < t.size() && t[i] == '.') {
+            ++i;
+            if (!digits()) return false;
+        }
+        if (i < t.size() && (t[i] == 'e' || t[i] == 'E')) {
+            ++i;
+            if (i < t.size() && (t[i] == '+' || t[i] == '-')) ++i;
+            if (!digits()) return false;
+        }
+        return i == t.size();
+    }
+
+    bool skip_value(int depth = 0) {
+        if (depth > 512) return fail("nesting too deep");
+        std::string_view ignored;
+        switch (peek()) {
+            case '"':
+                return parse_string(ignored);
+            case '{':
+                advance_structural();
+                if (peek() == '}') {
+                    advance_structural();
+                    return true;
+                }
+                for (;;) {
+                    if (!parse_string(ignored) || !expect(':') || !skip_value(depth + 1)) return false;
+                    if (peek() == ',') {
+                        advance_structural();
+                        continue;
+                    }
+                    return expect('}');
+                }
+            case '[':
+                advance_structural();
+                if (peek() == ']') {
+                    advance_structural();
+                    return true;
+                }
+                for (;;) {
+                    if (!skip_value(depth + 1)) return false;
+                    if (peek() == ',') {
+                        advance_structural();
+                        continue;
+                    }
+                    return expect(']');
+                }
+            case '\0':
+                return fail("unexpected end of input");
+            case '}': case ']': case ':': case ',':
+                return fail("unexpected character");
+            default:
+                return skip_scalar();
+        }
+    }
+
+    // Iterate the members of an object, calling member(key) positioned at
+    // each value; member must consume that value.
+    template <typename Member>
+    bool parse_object(Member&& member) {
+        if (!expect('{')) return false;
+        if (peek() == '}') {
+            advance_structural();
+            return true;
+        }
+        for (;;) {
+            std::string_view key;
+            if (!parse_string(key) || !expect(':') || !member(key)) return false;
+            if (peek() == ',') {
+                advance_structural();
+                continue;
+            }
+            return expect('}');
+        }
+    }
+
+    bool parse_root() {
+        return parse_object([this](std::string_view key) {
+            if (key == "packages") {
+                if (peek() != '{') return fail("\"packages\" must be an object");
+                return parse_object([this](std::string_view name) { return parse_package(name); });
+            }
+            if (key == "generation" && peek() != '"' && peek() != '{' && peek() != '[') {
+                std::size_t start = pos_;
+                if (!skip_scalar()) return false;
+                auto [end, ec] = std::from_chars(json_.data() + start, json_.data() + pos_, out_.generation);
+                if (ec != std::errc() || end != json_.data() + pos_) {
+                    pos_ = start;
+                    return fail("\"generation\" must be a non-negative integer");
+                }
+                return true;
+            }
+            peek();
+            std::size_t start = pos_;
+            if (!skip_value()) return false;
+            out_.extra_members.emplace_back(key, json_.substr(start, pos_ - start));
+            return true;
+        });
+    }
+
+    // A string-valued field; anything else is skipped and leaves it empty.
+    bool string_field(std::string_view& field) {
+        if (peek() == '"') return parse_string(field);
+        return skip_value();
+    }
+
+    bool parse_package(std::string_view name) {
+        if (peek() != '{') return skip_value();
+        std::size_t start = pos_;
+        RepoRecord rec;
+        rec.name = name;
+        rec.deps_begin = static_cast<uint32_t>(out_.dependencies.size());
+        rec.conflicts_begin = static_cast<uint32_t>(out_.conflicts.size());
+        rec.provides_begin = static_cast<uint32_t>(out_.provides.size());
+        bool ok = parse_object([this, &rec](std::string_view key) {
+            if (key == "version") return string_field(rec.version);
+            if (key == "description") return string_field(rec.description);
+            if (key == "arch") return string_field(rec.arch);
+            if (key == "license") return string_field(rec.license);
+            if (key == "maintainer") return string_field(rec.maintainer);
+            if (key == "url") return string_field(rec.url);
+            if (key == "dependencies") return parse_string_list(out_.dependencies);
+            if (key == "conflicts") return parse_string_list(out_.conflicts);
+            if (key == "provides") return parse_string_list(out_.provides);
+            return skip_value();
+        });
+        if (!ok) return false;
+        rec.json = json_.substr(start, pos_ - start);
+        rec.deps_count = static_cast<uint32_t>(out_.dependencies.size()) - rec.deps_begin;
+        rec.conflicts_count = static_cast<uint32_t>(out_.conflicts.size()) - rec.conflicts_begin;
+        rec.provides_count = static_cast<uint32_t>(out_.provides.size()) - rec.provides_begin;
+        out_.packages.push_back(rec);
+        return true;
+    }
+
+    // An array of strings, such as "dependencies"; other elements are skipped.
+    bool parse_string_list(std::vector<std::string_view>& out) {
+        if (peek() != '[') return skip_value();
+        advance_structural();
+        if (peek() == ']') {
+            advance_structural();
+            return true;
+        }
+        for (;;) {
+            if (peek() == '"') {
+                std::string_view dep;
+                if (!parse_string(dep)) return false;
+                out.push_back(dep);
+            } else if (!skip_value()) {
+                return false;
+            }
+            if (peek() == ',') {
+                advance_structural();
+                continue;
+            }
+            return expect(']');
+        }
+    }
+
+    std::string_view json_;
+    const std::vector<uint32_t>& idx_;
+    RepoRecords& out_;
+    std::size_t pos_ = 0;
+    std::size_t next_ = 0;
+    std::string scratch_;
+    std::string error_;
+};
+
+} // namespace
+
+void find_structurals(std::string_view json, std::vector<uint32_t>& out) {
+    ClassifyFn classify = kernel().classify;
+#ifdef FOX_SCAN_X86
+    if (classify == classify_avx2) {
+        find_structurals_with<classify_avx2>(json.data(), json.size(), out);
+        return;
+    }
+    if (classify == classify_sse2) {
+        find_structurals_with<classify_sse2>(json.data(), json.size(), out);
+        return;
+    }
+#endif
+    find_structurals_with<classify_scalar>(json.data(), json.size(), out);
+}
+
+const char* structural_scanner_name() {
+    return kernel().name;
+}
+
+bool scan_repo_json(std::string_view json, RepoRecords& out, std::string* error) {
+    if (json.size() > UINT32_MAX) {
+        if (error) *error = "repository file too large";
+        return false;
+    }
+    std::vector<uint32_t> structurals;
+    // Package metadata averages roughly one structural character per 8 bytes.
+    structurals.reserve(json.size() / 8 + 16);
+    find_structurals(json, structurals);
+
+    RecordParser parser(json, structurals, out);
+    if (!parser.parse()) {
+        if (error) *error = parser.error();
+        return false;
+    }
+    return true;
+}
+
+bool load_repo_records(const std::string& path, RepoRecords& out, std::string* error) {
+    if (!out.file.open(path)) {
+        if (error) *error = "cannot open " + path;
+        return false;
+    }
+    return scan_repo_json(out.file.view(), out, error);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "string_arena.hpp"
+
+// Fast repo.json ingestion.
+//
+// The file is mapped in one go and parsed in two stages. Stage 1 is a
+// vectorized scanner (AVX2 or SSE2 on x86, scalar elsewhere) that classifies
+// 64 bytes at a time and records the offset of every unescaped quote and of
+// every structural character ({}[]:,) outside a string. Stage 2 walks those
+// offsets and fills RepoRecord values directly, so string ends are never
+// searched for byte by byte and no DOM is built.
+
+// One package from repo.json. Fields are views into the mapped file or, for
+// strings that contained escape sequences, into RepoRecords::arena.
+struct RepoRecord {
+    std::string_view name;
+    std::string_view version;
+    std::string_view description;
+    std::string_view arch;
+    std::string_view license;
+    std::string_view maintainer;
+    std::string_view url;
+    std::string_view json;        // raw text of the whole package object
+    std::string_view repository;  // set when merging; repo.json does not carry it
+    uint32_t deps_begin = 0;
+    uint32_t deps_count = 0;
+    uint32_t conflicts_begin = 0;
+    uint32_t conflicts_count = 0;
+    uint32_t provides_begin = 0;
+    uint32_t provides_count = 0;
+};
+
+// Parsed repository together with the storage its views point into.
+struct RepoRecords {
+    uint64_t generation = 0;  // top-level "generation", 0 when absent
+    std::vector<RepoRecord> packages;
+    std::vector<std::string_view> dependencies;
+    std::vector<std::string_view> conflicts;
+    std::vector<std::string_view> provides;
+    // Other top-level members as (key, raw value text), kept so a rewritten
+    // repo.json can carry them through unchanged.
+    std::vector<std::pair<std::string_view, std::string_view>> extra_members;
+    StringArena arena;
+    MappedFile file;
+};
+
+// Stage 1 on its own: append the offset of every unescaped quote and every
+// structural character outside a string to out.
+void find_structurals(std::string_view json, std::vector<uint32_t>& out);
+
+// Name of the stage 1 kernel picked for this CPU: "avx2", "sse2" or "scalar".
+const char* structural_scanner_name();
+
+// Parse an in-memory repo.json. Views in out point into json, which must
+// outlive them. On failure error (if given) describes the first problem.
+bool scan_repo_json(std::string_view json, RepoRecords& out, std::string* error = nullptr);
+
+// Map the file at path and parse it; out.file keeps the mapping alive.
+bool load_repo_records(const std::string& path, RepoRecords& out, std::string* error = nullptr);
@@ -0,0 +1,288 @@
+#include "repo_search.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+#include "mapped_file.hpp"
+#include "repo_trigram.hpp"
+
+namespace {
+
+// BM25 parameters: term frequency saturation and length normalization.
+constexpr double BM25_K1 = 1.2;
+constexpr double BM25_B = 0.75;
+// A query token that is only a prefix of a term scores less than an exact
+// match, so "fox" ranks a package named fox above one named foxglove.
+constexpr double PREFIX_DISCOUNT = 0.5;
+
+bool token_byte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+template <typename T>
+void append(std::string& out, const T* data, std::size_t count) {
+    out.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+}
+
+// Packages matching one query token, by id, with that token's score.
+using Matches = std::vector<std::pair<uint32_t, double>>;
+
+class TermReader {
+public:
+    bool open(const std::string& path, uint32_t package_count) {
+        if (!file_.open(path) || file_.size() < sizeof(TermsHeader)) return false;
+        header_ = reinterpret_cast<const TermsHeader*>(file_.data());
+        return std::memcmp(header_->magic, REPO_TERMS_MAGIC, sizeof(header_->magic)) == 0 &&
+               header_->version == REPO_INDEX_VERSION && header_->package_count == package_count &&
+               header_->terms_offset + uint64_t(header_->term_count) * sizeof(TermEntry) <= header_->postings_offset &&
+               header_->postings_offset + uint64_t(header_->posting_count) * sizeof(Posting) <= header_->lengths_offset &&
+               header_->lengths_offset + uint64_t(package_count) * sizeof(uint32_t) <= header_->strings_offset &&
+               header_->strings_offset + header_->strings_size <= file_.size();
+    }
+
+    // Score every package containing a term that starts with token.
+    Matches match(const std::string& token) const {
+        const auto* terms = reinterpret_cast<const TermEntry*>(file_.data() + header_->terms_offset);
+        const auto* postings = reinterpret_cast<const Posting*>(file_.data() + header_->postings_offset);
+        const auto* lengths = reinterpret_cast<const uint32_t*>(file_.data() + header_->lengths_offset);
+        const TermEntry* end = terms + header_->term_count;
+        const TermEntry* it = std::lower_bound(terms, end, token,
+            [this](const TermEntry& t, const std::string& key) { return text(t) < key; });
+
+        const double n = header_->package_count;
+        const double average = header_->total_length / std::max(1.0, n);
+        Matches matches;
+        for (; it != end && text(*it).substr(0, token.size()) == token; ++it) {
+            double df = it->postings_count;
+            double idf = std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+            if (text(*it).size() != token.size()) idf *= PREFIX_DISCOUNT;
+            for (uint32_t p = 0; p < it->postings_count; ++p) {
+                const Posting& posting = postings[it->postings_begin + p];
+                double tf = posting.frequency;
+                double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * lengths[posting.package] / average);
+                matches.emplace_back(posting.package, idf * tf * (BM25_K1 + 1.0) / (tf + norm));
+            }
+        }
+        // Postings of different terms interleave; fold them into one entry
+        // per package.
+        std::sort(matches.begin(), matches.end());
+        std::size_t out = 0;
+        for (std::size_t i = 0; i < matches.size(); ++i) {
+            if (out > 0 && matches[out - 1].first == matches[i].first) {
+                matches[out - 1].second += matches[i].second;
+            } else {
+                matches[out++] = matches[i];
+            }
+        }
+        matches.resize(out);
+        return matches;
+    }
+
+private:
+    std::string_view text(const TermEntry& t) const {
+        return std::string_view(file_.data() + header_->strings_offset + t.text.offset, t.text.length);
+    }
+
+    MappedFile file_;
+    const TermsHeader* header_ = nullptr;
+};
+
+// Keep the packages of acc that also appear in other, adding their scores.
+// other is probed by binary search from the last position, so the cost
+// follows the smaller list.
+void intersect(Matches& acc, const Matches& other) {
+    std::size_t out = 0;
+    auto from = other.begin();
+    for (const auto& [package, score] : acc) {
+        from = std::lower_bound(from, other.end(), package,
+            [](const std::pair<uint32_t, double>& m, uint32_t id) { return m.first < id; });
+        if (from == other.end()) break;
+        if (from->first == package) acc[out++] = {package, score + from->second};
+    }
+    acc.resize(out);
+}
+
+} // namespace
+
+void search_tokens(std::string_view text, std::vector<std::string>& out) {
+    std::size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && !token_byte(static_cast<unsigned char>(text[i]))) ++i;
+        std::size_t start = i;
+        while (i < text.size() && token_byte(static_cast<unsigned char>(text[i]))) ++i;
+        if (i == start) continue;
+        std::string token(text.substr(start, i - start));
+        for (char& c : token) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        }
+        out.push_back(std::move(token));
+    }
+}
+
+std::string build_term_index(const std::vector<std::string_view>& names,
+                             const std::vector<std::string_view>& descriptions) {
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> texts;
+    std::vector<std::vector<Posting>> postings;
+    std::vector<uint32_t> lengths(names.size());
+    uint64_t total_length = 0;
+
+    std::vector<std::string> name_tokens;
+    std::vector<std::string> description_tokens;
+    std::vector<std::pair<std::string_view, uint32_t>> counts;
+    for (uint32_t id = 0; id < names.size(); ++id) {
+        name_tokens.clear();
+        description_tokens.clear();
+        search_tokens(names[id], name_tokens);
+        search_tokens(descriptions[id], description_tokens);
+        counts.clear();
+        for (const std::string& t : name_tokens) counts.emplace_back(t, SEARCH_NAME_WEIGHT);
+        for (const std::string& t : description_tokens) counts.emplace_back(t, 1);
+        std::sort(counts.begin(), counts.end());
+        lengths[id] = static_cast<uint32_t>(name_tokens.size() + description_tokens.size());
+        total_length += lengths[id];
+
+        for (std::size_t i = 0; i < counts.size();) {
+            std::string_view token = counts[i].first;
+            uint32_t frequency = 0;
+            for (; i < counts.size() && counts[i].first == token; ++i) frequency += counts[i].second;
+            auto [it, inserted] = ids.try_emplace(std::string(token), static_cast<uint32_t>(texts.size()));
+            if (inserted) {
+                texts.emplace_back(token);
+                postings.emplace_back();
+            }
+            postings[it->second].push_back({id, frequency});
+        }
+    }
+
+    std::vector<uint32_t> order(texts.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&texts](uint32_t a, uint32_t b) { return texts[a] < texts[b]; });
+
+    std::vector<TermEntry> entries;
+    std::vector<Posting> all_postings;
+    std::string blob;
+    entries.reserve(order.size());
+    for (uint32_t t : order) {
+        entries.push_back({{static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(texts[t].size())},
+                           static_cast<uint32_t>(all_postings.size()), static_cast<uint32_t>(postings[t].size())});
+        blob += texts[t];
+        all_postings.insert(all_postings.end(), postings[t].begin(), postings[t].end());
+    }
+
+    TermsHeader header{};
+    std::memcpy(header.magic, REPO_TERMS_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.term_count = static_cast<uint32_t>(entries.size());
+    header.package_count = static_cast<uint32_t>(names.size());
+    header.posting_count = static_cast<uint32_t>(all_postings.size());
+    header.total_length = total_length;
+    header.terms_offset = sizeof(TermsHeader);
+    header.postings_offset = header.terms_offset + entries.size() * sizeof(TermEntry);
+    header.lengths_offset = header.postings_offset + all_postings.size() * sizeof(Posting);
+    header.strings_offset = header.lengths_offset + lengths.size() * sizeof(uint32_t);
+    header.strings_size = blob.size();
+
+    std::string bytes;
+    bytes.reserve(header.strings_offset + blob.size());
+    append(bytes, &header, 1);
+    append(bytes, entries.data(), entries.size());
+    append(bytes, all_postings.data(), all_postings.size());
+    append(bytes, lengths.data(), lengths.size());
+    bytes.append(blob);
+    return bytes;
+}
+
+namespace {
+
+// Packages matching every token of query, by id, with their BM25 scores.
+// Sets all_packages instead when the query has no tokens.
+bool word_matches(const RepoIndex& index, std::string_view query, Matches& matches, bool& all_packages) {
+    matches.clear();
+    std::vector<std::string> tokens;
+    search_tokens(query, tokens);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    all_packages = tokens.empty();
+    if (all_packages) return true;
+
+    TermReader reader;
+    if (!reader.open(index.terms_path(), index.size())) return false;
+    std::vector<Matches> lists;
+    for (const std::string& token : tokens) {
+        lists.push_back(reader.match(token));
+        if (lists.back().empty()) return true;
+    }
+    std::sort(lists.begin(), lists.end(), [](const Matches& a, const Matches& b) { return a.size() < b.size(); });
+    matches = std::move(lists[0]);
+    for (std::size_t i = 1; i < lists.size() && !matches.empty(); ++i) intersect(matches, lists[i]);
+    return true;
+}
+
+// The best `limit` of matches, highest score first.
+void best_hits(const Matches& matches, std::size_t limit, std::vector<SearchHit>& hits) {
+    // Bounded min-heap of the best `limit` hits; on equal scores the lower id
+    // (earlier name) is better.
+    auto better = [](const SearchHit& a, const SearchHit& b) {
+        return a.score != b.score ? a.score > b.score : a.package < b.package;
+    };
+    std::priority_queue<SearchHit, std::vector<SearchHit>, decltype(better)> best(better);
+    for (const auto& [package, score] : matches) {
+        if (limit == 0) break;
+        SearchHit hit{package, score};
+        if (best.size() < limit) {
+            best.push(hit);
+        } else if (better(hit, best.top())) {
+            best.pop();
+            best.push(hit);
+        }
+    }
+    hits.resize(best.size());
+    for (std::size_t i = hits.size(); i-- > 0; best.pop()) hits[i] = best.top();
+}
+
+} // namespace
+
+bool search_repo_index(const RepoIndex& index, std::string_view query, std::size_t limit,
+                       std::vector<SearchHit>& hits, std::size_t* total) {
+    hits.clear();
+    Matches matches;
+    bool all_packages = false;
+    if (!word_matches(index, query, matches, all_packages)) return false;
+    if (all_packages) {
+        if (total) *total = index.size();
+        for (uint32_t id = 0; id < index.size() && hits.size() < limit; ++id) hits.push_back({id, 0.0});
+        return true;
+    }
+    if (total) *total = matches.size();
+    best_hits(matches, limit, hits);
+    return true;
+}
+
+bool search_ranked_substring(const RepoIndex& index, std::string_view query, std::size_t limit,
+                             std::vector<SearchHit>& hits, std::size_t* total) {
+    hits.clear();
+    std::vector<uint32_t> ids;
+    if (!search_substring(index, query, false, ids)) return false;
+    if (total) *total = ids.size();
+    Matches ranked;
+    ranked.reserve(ids.size());
+    for (uint32_t id : ids) ranked.emplace_back(id, 0.0);
+
+    // Both lists are in id order; substring matches that also match word by
+    // word take their score.
+    Matches scored;
+    bool all_packages = false;
+    if (!ids.empty() && !word_matches(index, query, scored, all_packages)) return false;
+    auto from = scored.begin();
+    for (auto& entry : ranked) {
+        while (from != scored.end() && from->first < entry.first) ++from;
+        if (from == scored.end()) break;
+        if (from->first == entry.first) entry.second = from->second;
+    }
+    best_hits(ranked, limit, hits);
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "repo_index.hpp"
+
+// Ranked package search.
+//
+// Names and descriptions are split into lower-cased tokens (runs of ASCII
+// letters and digits; bytes outside ASCII are kept as part of a token), and
+// an inverted index from token to the packages containing it is stored with
+// the binary index:
+//
+//   TermsHeader
+//   TermEntry[term_count]     sorted by text
+//   Posting[posting_count]    per term, sorted by package id
+//   uint32_t[package_count]   token count of each package
+//   char[strings_size]        term text
+//
+// A query token matches every term it is a prefix of. Packages must match
+// all query tokens; they are ranked with BM25, counting a token in the name
+// SEARCH_NAME_WEIGHT times, and only the best `limit` are kept.
+
+constexpr char REPO_TERMS_MAGIC[8] = {'F', 'O', 'X', 'T', 'E', 'R', 'M', '\0'};
+constexpr uint32_t SEARCH_NAME_WEIGHT = 3;
+
+struct TermsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t term_count;
+    uint32_t package_count;
+    uint32_t posting_count;
+    uint64_t total_length;  // sum of all package token counts
+    uint64_t terms_offset;
+    uint64_t postings_offset;
+    uint64_t lengths_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct TermEntry {
+    StrRef text;
+    uint32_t postings_begin;
+    uint32_t postings_count;
+};
+
+struct Posting {
+    uint32_t package;
+    uint32_t frequency;  // weighted: name occurrences count SEARCH_NAME_WEIGHT times
+};
+
+struct SearchHit {
+    uint32_t package;
+    double score;
+};
+
+// Append the search tokens of text to out.
+void search_tokens(std::string_view text, std::vector<std::string>& out);
+
+// Serialize the term index for packages 0..n-1 with the given names and
+// descriptions.
+std::string build_term_index(const std::vector<std::string_view>& names,
+                             const std::vector<std::string_view>& descriptions);
+
+// Best matches for query, highest score first (ties in name order). total,
+// if given, receives the number of packages that matched. An empty query
+// matches every package. Returns false if the term index cannot be read.
+bool search_repo_index(const RepoIndex& index, std::string_view query, std::size_t limit,
+                       std::vector<SearchHit>& hits, std::size_t* total = nullptr);
+
+// What `fox search` shows: the packages whose name or description contains
+// query exactly (see search_substring() in repo_trigram.hpp), so the same
+// packages match whether or not the index has been built. Those that also
+// match query word by word come first, by score; the others follow in name
+// order. total, if given, receives the number of substring matches.
+bool search_ranked_substring(const RepoIndex& index, std::string_view query, std::size_t limit,
+                             std::vector<SearchHit>& hits, std::size_t* total = nullptr);
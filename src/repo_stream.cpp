@@ -0,0 +1,160 @@
+#include "repo_stream.hpp"
+
+#include <fstream>
+
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+enum class Field { Other, Name, Version, Description, Arch, License, Maintainer, Url, Dependencies };
+
+Field field_for_key(const std::string& key) {
+    if (key == "name") return Field::Name;
+    if (key == "version") return Field::Version;
+    if (key == "description") return Field::Description;
+    if (key == "arch") return Field::Arch;
+    if (key == "license") return Field::License;
+    if (key == "maintainer") return Field::Maintainer;
+    if (key == "url") return Field::Url;
+    if (key == "dependencies") return Field::Dependencies;
+    return Field::Other;
+}
+
+// SAX consumer for {"packages": {"<name>": {...}, ...}}. Depth 1 is the root
+// object, depth 2 the packages object and depth 3 a single package.
+class SearchHandler {
+public:
+    SearchHandler(std::string_view query, const std::function<bool(const PackageView&)>& on_match)
+        : query_(query), on_match_(on_match) {}
+
+    std::size_t scanned() const { return scanned_; }
+
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number_integer(json::number_integer_t) { return true; }
+    bool number_unsigned(json::number_unsigned_t) { return true; }
+    bool number_float(json::number_float_t, const std::string&) { return true; }
+    bool binary(json::binary_t&) { return true; }
+
+    bool string(std::string& val) {
+        if (depth_ == 4 && in_deps_) {
+            ++deps_count_;
+            return true;
+        }
+        if (depth_ != 3) return true;
+        switch (field_) {
+            case Field::Name: name_.swap(val); has_name_ = true; break;
+            case Field::Version: version_.swap(val); break;
+            case Field::Description: description_.swap(val); break;
+            case Field::Arch: arch_.swap(val); break;
+            case Field::License: license_.swap(val); break;
+            case Field::Maintainer: maintainer_.swap(val); break;
+            case Field::Url: url_.swap(val); break;
+            default: break;
+        }
+        return true;
+    }
+
+    bool key(std::string& val) {
+        if (depth_ == 1) {
+            in_packages_ = val == "packages";
+        } else if (depth_ == 2 && in_packages_) {
+            key_.swap(val);
+        } else if (depth_ == 3 && in_packages_) {
+            field_ = field_for_key(val);
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        ++depth_;
+        if (depth_ == 3 && in_packages_) begin_package();
+        return true;
+    }
+
+    bool end_object() {
+        bool keep_going = true;
+        if (depth_ == 3 && in_packages_) keep_going = end_package();
+        --depth_;
+        return keep_going;
+    }
+
+    bool start_array(std::size_t) {
+        ++depth_;
+        in_deps_ = depth_ == 4 && in_packages_ && field_ == Field::Dependencies;
+        return true;
+    }
+
+    bool end_array() {
+        --depth_;
+        in_deps_ = false;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) {
+        failed_ = true;
+        return false;
+    }
+
+    bool failed() const { return failed_; }
+
+private:
+    bool contains(const std::string& s) const {
+        return s.find(query_) != std::string::npos;
+    }
+
+    void begin_package() {
+        for (std::string* s : {&name_, &version_, &description_, &arch_, &license_, &maintainer_, &url_}) {
+            s->clear();
+        }
+        field_ = Field::Other;
+        has_name_ = false;
+        deps_count_ = 0;
+    }
+
+    bool end_package() {
+        ++scanned_;
+        // A package without a "name" field is known by its key.
+        const std::string& name = has_name_ ? name_ : key_;
+        if (!contains(name) && !contains(description_)) return true;
+        PackageView view;
+        view.name = name;
+        view.version = version_;
+        view.description = description_;
+        view.arch = arch_;
+        view.license = license_;
+        view.maintainer = maintainer_;
+        view.url = url_;
+        view.deps_count = deps_count_;
+        return on_match_(view);
+    }
+
+    std::string_view query_;
+    const std::function<bool(const PackageView&)>& on_match_;
+
+    int depth_ = 0;
+    bool in_packages_ = false;
+    bool in_deps_ = false;
+    Field field_ = Field::Other;
+    bool has_name_ = false;
+    uint32_t deps_count_ = 0;
+    std::size_t scanned_ = 0;
+    bool failed_ = false;
+
+    std::string key_, name_, version_, description_, arch_, license_, maintainer_, url_;
+};
+
+} // namespace
+
+bool stream_search_repo_json(const std::string& repo_path, std::string_view query,
+                             const std::function<bool(const PackageView&)>& on_match,
+                             std::size_t* scanned) {
+    std::ifstream repo_file(repo_path, std::ios::binary);
+    if (!repo_file.is_open()) return false;
+    SearchHandler handler(query, on_match);
+    json::sax_parse(repo_file, &handler);
+    if (scanned) *scanned = handler.scanned();
+    return !handler.failed();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "repo_index.hpp"
+
+// Streaming search over repo.json.
+//
+// The file is fed through nlohmann's SAX interface, so no DOM is ever built:
+// each package's fields are collected into a handful of reused buffers, the
+// package is tested against the query as soon as its object closes, and only
+// matching packages are handed to on_match. Memory use is independent of the
+// repository size and results arrive while the file is still being read.
+// The views passed to on_match are valid for the duration of the callback
+// only; id is REPO_INDEX_NPOS and deps_count is the number of dependency
+// strings seen. Returning false from on_match stops the scan.
+//
+// Returns false if repo.json cannot be opened or is not valid JSON.
+bool stream_search_repo_json(const std::string& repo_path, std::string_view query,
+                             const std::function<bool(const PackageView&)>& on_match,
+                             std::size_t* scanned = nullptr);
@@ -0,0 +1,245 @@
+#include "repo_trigram.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "mapped_file.hpp"
+#include "text_scan.hpp"
+
+namespace {
+
+uint32_t trigram_at(std::string_view s, std::size_t i) {
+    return uint32_t(static_cast<unsigned char>(s[i])) << 16 | uint32_t(static_cast<unsigned char>(s[i + 1])) << 8 |
+           uint32_t(static_cast<unsigned char>(s[i + 2]));
+}
+
+void add_trigrams(std::string_view s, std::vector<uint32_t>& out) {
+    for (std::size_t i = 0; i + 3 <= s.size(); ++i) out.push_back(trigram_at(s, i));
+}
+
+void put_varint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Sequential reader over one posting list.
+class PostingCursor {
+public:
+    PostingCursor(const uint8_t* data, const uint8_t* end, uint32_t count)
+        : data_(data), end_(end), remaining_(count) {}
+
+    // Next id, or false at the end of the list (or on corrupt data).
+    bool next(uint32_t& id) {
+        if (remaining_ == 0) return false;
+        uint32_t gap = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (data_ == end_) return false;
+            uint8_t byte = *data_++;
+            gap |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        id = first_ ? gap : last_ + gap;
+        first_ = false;
+        last_ = id;
+        --remaining_;
+        return true;
+    }
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+    uint32_t remaining_;
+    uint32_t last_ = 0;
+    bool first_ = true;
+};
+
+bool contains(const RepoIndex& index, uint32_t id, std::string_view query) {
+    PackageView pkg = index.package(id);
+    return pkg.name.find(query) != std::string_view::npos || pkg.description.find(query) != std::string_view::npos;
+}
+
+// Scan the packed text table. A hit in a package's text skips straight to
+// the next package, so each package is reported at most once.
+bool scan_text_table(const RepoIndex& index, std::string_view query, bool ignore_case,
+                     std::vector<uint32_t>& matches) {
+    MappedFile file;
+    if (!file.open(index.text_path()) || file.size() < sizeof(TextTableHeader)) return false;
+    const auto* header = reinterpret_cast<const TextTableHeader*>(file.data());
+    if (std::memcmp(header->magic, REPO_TEXT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_INDEX_VERSION || header->package_count != index.size() ||
+        header->offsets_offset + (uint64_t(header->package_count) + 1) * sizeof(uint32_t) > header->blob_offset ||
+        header->blob_offset + header->blob_size > file.size()) {
+        return false;
+    }
+    const auto* offsets = reinterpret_cast<const uint32_t*>(file.data() + header->offsets_offset);
+    const uint32_t* offsets_end = offsets + header->package_count + 1;
+    std::string_view blob(file.data() + header->blob_offset, header->blob_size);
+    if (offsets[header->package_count] != blob.size()) return false;
+
+    std::size_t pos = 0;
+    while (pos < blob.size()) {
+        std::size_t hit = find_text(blob.substr(pos), query, ignore_case);
+        if (hit == std::string_view::npos) break;
+        std::size_t at = pos + hit;
+        uint32_t id = static_cast<uint32_t>(std::upper_bound(offsets, offsets_end, at) - offsets - 1);
+        matches.push_back(id);
+        pos = offsets[id + 1];
+    }
+    return true;
+}
+
+} // namespace
+
+std::string build_trigram_index(const std::vector<std::string_view>& names,
+                                const std::vector<std::string_view>& descriptions) {
+    std::unordered_map<uint32_t, std::vector<uint32_t>> lists;
+    std::vector<uint32_t> trigrams;
+    for (uint32_t id = 0; id < names.size(); ++id) {
+        trigrams.clear();
+        add_trigrams(names[id], trigrams);
+        add_trigrams(descriptions[id], trigrams);
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        for (uint32_t t : trigrams) lists[t].push_back(id);
+    }
+
+    std::vector<uint32_t> keys;
+    keys.reserve(lists.size());
+    for (const auto& entry : lists) keys.push_back(entry.first);
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<TrigramEntry> table;
+    std::string postings;
+    table.reserve(keys.size());
+    for (uint32_t t : keys) {
+        const std::vector<uint32_t>& ids = lists[t];
+        table.push_back({t, static_cast<uint32_t>(ids.size()), postings.size()});
+        uint32_t last = 0;
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            put_varint(postings, i == 0 ? ids[i] : ids[i] - last);
+            last = ids[i];
+        }
+    }
+
+    TrigramHeader header{};
+    std::memcpy(header.magic, REPO_TRIGRAM_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.trigram_count = static_cast<uint32_t>(table.size());
+    header.package_count = static_cast<uint32_t>(names.size());
+    header.table_offset = sizeof(TrigramHeader);
+    header.postings_offset = header.table_offset + table.size() * sizeof(TrigramEntry);
+    header.postings_size = postings.size();
+
+    std::string bytes;
+    bytes.reserve(header.postings_offset + postings.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(TrigramEntry));
+    bytes.append(postings);
+    return bytes;
+}
+
+std::string build_text_table(const std::vector<std::string_view>& names,
+                             const std::vector<std::string_view>& descriptions) {
+    std::vector<uint32_t> offsets;
+    offsets.reserve(names.size() + 1);
+    std::string blob;
+    for (std::size_t id = 0; id < names.size(); ++id) {
+        offsets.push_back(static_cast<uint32_t>(blob.size()));
+        blob.append(names[id]);
+        blob.push_back('\n');
+        blob.append(descriptions[id]);
+        blob.push_back('\n');
+    }
+    offsets.push_back(static_cast<uint32_t>(blob.size()));
+
+    TextTableHeader header{};
+    std::memcpy(header.magic, REPO_TEXT_MAGIC, sizeof(header.magic));
+    header.version = REPO_INDEX_VERSION;
+    header.package_count = static_cast<uint32_t>(names.size());
+    header.offsets_offset = sizeof(TextTableHeader);
+    header.blob_offset = header.offsets_offset + offsets.size() * sizeof(uint32_t);
+    header.blob_size = blob.size();
+
+    std::string bytes;
+    bytes.reserve(header.blob_offset + blob.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    bytes.append(blob);
+    return bytes;
+}
+
+bool search_substring(const RepoIndex& index, std::string_view query, bool ignore_case,
+                      std::vector<uint32_t>& matches, std::size_t* candidates) {
+    matches.clear();
+    // The separator would let a match run from a name into its description.
+    if (query.empty() || query.find('\n') != std::string_view::npos) {
+        for (uint32_t id = 0; id < index.size(); ++id) {
+            if (contains(index, id, query)) matches.push_back(id);
+        }
+        if (candidates) *candidates = index.size();
+        return true;
+    }
+    if (query.size() < 3 || ignore_case) {
+        // Nothing the trigrams can narrow: scan all text in one pass.
+        if (candidates) *candidates = index.size();
+        return scan_text_table(index, query, ignore_case, matches);
+    }
+
+    MappedFile file;
+    if (!file.open(index.trigrams_path()) || file.size() < sizeof(TrigramHeader)) return false;
+    const auto* header = reinterpret_cast<const TrigramHeader*>(file.data());
+    if (std::memcmp(header->magic, REPO_TRIGRAM_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != REPO_INDEX_VERSION || header->package_count != index.size() ||
+        header->table_offset + uint64_t(header->trigram_count) * sizeof(TrigramEntry) > header->postings_offset ||
+        header->postings_offset + header->postings_size > file.size()) {
+        return false;
+    }
+    const auto* table = reinterpret_cast<const TrigramEntry*>(file.data() + header->table_offset);
+    const auto* postings = reinterpret_cast<const uint8_t*>(file.data() + header->postings_offset);
+    const uint8_t* postings_end = postings + header->postings_size;
+
+    std::vector<uint32_t> trigrams;
+    add_trigrams(query, trigrams);
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    std::vector<const TrigramEntry*> entries;
+    for (uint32_t t : trigrams) {
+        const TrigramEntry* it = std::lower_bound(table, table + header->trigram_count, t,
+            [](const TrigramEntry& e, uint32_t key) { return e.trigram < key; });
+        if (it == table + header->trigram_count || it->trigram != t || it->offset > header->postings_size) {
+            if (candidates) *candidates = 0;
+            return true;
+        }
+        entries.push_back(it);
+    }
+    // Start from the rarest trigram so the candidate set is small from the
+    // beginning; each further list only removes candidates.
+    std::sort(entries.begin(), entries.end(),
+              [](const TrigramEntry* a, const TrigramEntry* b) { return a->count < b->count; });
+
+    std::vector<uint32_t> survivors;
+    PostingCursor first(postings + entries[0]->offset, postings_end, entries[0]->count);
+    for (uint32_t id; first.next(id);) survivors.push_back(id);
+    for (std::size_t e = 1; e < entries.size() && !survivors.empty(); ++e) {
+        PostingCursor cursor(postings + entries[e]->offset, postings_end, entries[e]->count);
+        std::size_t out = 0;
+        uint32_t id = 0;
+        bool more = cursor.next(id);
+        for (uint32_t candidate : survivors) {
+            while (more && id < candidate) more = cursor.next(id);
+            if (!more) break;
+            if (id == candidate) survivors[out++] = candidate;
+        }
+        survivors.resize(out);
+    }
+
+    if (candidates) *candidates = survivors.size();
+    for (uint32_t id : survivors) {
+        if (contains(index, id, query)) matches.push_back(id);
+    }
+    return true;
+}
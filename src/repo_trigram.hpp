@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "repo_index.hpp"
+
+// Exact substring search backed by a trigram index.
+//
+// Every 3-byte sequence of each package name and description is indexed
+// (case-sensitive, byte for byte, like std::string::find). A query of three
+// bytes or more can then only match packages that contain all of its
+// trigrams; the posting lists of those trigrams are intersected and the
+// exact substring check runs on the survivors only.
+//
+//   TrigramHeader
+//   TrigramEntry[trigram_count]  sorted by trigram
+//   uint8_t[postings_size]       per trigram, ascending package ids as
+//                                LEB128 varints of the gap to the previous id
+//
+// Queries the trigrams cannot narrow (shorter than three bytes, or case-
+// insensitive) scan a packed text table instead: every package's name and
+// description, one after the other, in a single blob that is searched with
+// find_text() (see text_scan.hpp). Hit offsets map back to package ids
+// through the offset table.
+//
+//   TextTableHeader
+//   uint32_t[package_count + 1]  offset of each package's text in the blob
+//   char[blob_size]              "<name>\n<description>\n" per package
+
+constexpr char REPO_TRIGRAM_MAGIC[8] = {'F', 'O', 'X', 'T', 'R', 'G', 'M', '\0'};
+
+struct TrigramHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t trigram_count;
+    uint32_t package_count;
+    uint32_t reserved;
+    uint64_t table_offset;
+    uint64_t postings_offset;
+    uint64_t postings_size;
+};
+
+constexpr char REPO_TEXT_MAGIC[8] = {'F', 'O', 'X', 'T', 'E', 'X', 'T', '\0'};
+
+struct TextTableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t package_count;
+    uint64_t offsets_offset;
+    uint64_t blob_offset;
+    uint64_t blob_size;
+};
+
+struct TrigramEntry {
+    uint32_t trigram;  // the three bytes, first byte most significant
+    uint32_t count;    // packages containing it
+    uint64_t offset;   // of its posting list within the postings
+};
+
+// Serialize the trigram index for packages 0..n-1.
+std::string build_trigram_index(const std::vector<std::string_view>& names,
+                                const std::vector<std::string_view>& descriptions);
+
+// Serialize the packed text table for packages 0..n-1.
+std::string build_text_table(const std::vector<std::string_view>& names,
+                             const std::vector<std::string_view>& descriptions);
+
+// Ids, in name order, of the packages whose name or description contains
+// query, ignoring ASCII case if asked to. candidates, if given, receives how
+// many packages had their text checked. Returns false if the trigram index
+// or text table cannot be read.
+bool search_substring(const RepoIndex& index, std::string_view query, bool ignore_case,
+                      std::vector<uint32_t>& matches, std::size_t* candidates = nullptr);
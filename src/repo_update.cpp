@@ -0,0 +1,334 @@
+#include "repo_update.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "nlohmann/json.hpp"
+#include "repo_contents.hpp"
+#include "repo_delta.hpp"
+#include "repo_scan.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+bool ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Run a shell command, capturing its stdout. Returns the exit status, or -1
+// if the command could not be started.
+int run_capture(const std::string& cmd, std::string& output) {
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return -1;
+    char buf[256];
+    std::size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) output.append(buf, n);
+    int status = pclose(pipe);
+    if (status == -1 || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+}
+
+std::string read_line(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+void remove_quietly(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+// curl exit codes for "the resource is not there": file:// not found,
+// FTP/SFTP/SCP missing file. HTTP 404s are reported through the status code.
+bool missing_resource_exit(int code) {
+    return code == 37 || code == 78 || code == 9;
+}
+
+struct FetchResult {
+    int exit_code = -1;
+    std::string http_code;
+    std::string error;
+
+    // Non-HTTP transfers (file://) report 000.
+    bool ok() const { return exit_code == 0 && (http_code == "200" || http_code == "000"); }
+    bool missing() const {
+        return (exit_code == 0 && (http_code == "404" || http_code == "410")) ||
+               missing_resource_exit(exit_code);
+    }
+    std::string describe(const std::string& url) const {
+        if (exit_code != 0) {
+            return error.empty() ? "curl failed with exit code " + std::to_string(exit_code) : error;
+        }
+        return "server returned HTTP " + http_code + " for " + url;
+    }
+};
+
+// Download url to out_path with curl. extra_args are inserted verbatim and
+// must already be quoted.
+FetchResult curl_fetch(const std::string& url, const std::string& out_path, const std::string& extra_args = "") {
+    FetchResult result;
+    std::string error_path = out_path + ".err";
+    std::string cmd = "curl -sSL -R -o " + shell_quote(out_path) + " -w '%{http_code}'" + extra_args +
+                      " " + shell_quote(url) + " 2> " + shell_quote(error_path);
+    result.exit_code = run_capture(cmd, result.http_code);
+    if (result.exit_code != 0) result.error = read_line(error_path);
+    remove_quietly(error_path);
+    if (!result.ok()) remove_quietly(out_path);
+    return result;
+}
+
+// URL of the directory holding repo.json, with a trailing slash.
+std::string repo_base_url(const std::string& url) {
+    std::size_t slash = url.rfind('/');
+    return slash == std::string::npos ? std::string() : url.substr(0, slash + 1);
+}
+
+// Try to bring repo_path up to date by applying published deltas. Returns
+// Failed (with an empty error) whenever a full fetch should be used instead.
+UpdateResult update_from_deltas(const std::string& url, const std::string& repo_path,
+                                const std::string& state_dir) {
+    UpdateResult result;
+    const std::string base = repo_base_url(url);
+    const std::string pid = std::to_string(getpid());
+    const std::string scratch = repo_path + ".delta." + pid;
+    if (base.empty()) return result;
+
+    if (!curl_fetch(base + "generation.json", scratch).ok()) return result;
+    json manifest;
+    {
+        std::ifstream in(scratch);
+        manifest = json::parse(in, nullptr, false);
+    }
+    remove_quietly(scratch);
+    if (!manifest.is_object()) return result;
+    uint64_t latest = manifest.value("generation", uint64_t(0));
+    uint64_t oldest = manifest.value("oldest", latest);
+
+    RepoRecords local;
+    if (!load_repo_records(repo_path, local)) return result;
+    uint64_t current = local.generation;
+    result.source = base + "generation.json";
+    if (current != 0 && current == latest) {
+        result.status = UpdateStatus::NotModified;
+        return result;
+    }
+    if (current == 0 || current > latest || current < oldest || latest - current > MAX_DELTA_CHAIN) {
+        return result;
+    }
+
+    std::vector<json> deltas;
+    for (uint64_t g = current + 1; g <= latest; ++g) {
+        if (!curl_fetch(base + "deltas/" + std::to_string(g) + ".json", scratch).ok()) return result;
+        std::ifstream in(scratch);
+        deltas.push_back(json::parse(in, nullptr, false));
+        in.close();
+        remove_quietly(scratch);
+        if (deltas.back().is_discarded()) return result;
+    }
+
+    const std::string staged = repo_path + ".new." + pid;
+    std::string error;
+    RepoRecords check;
+    if (!apply_repo_deltas(local, deltas, staged, error) || !load_repo_records(staged, check) ||
+        check.generation != latest || std::rename(staged.c_str(), repo_path.c_str()) != 0) {
+        remove_quietly(staged);
+        return result;
+    }
+    // The patched file is not byte-identical to the server's repo.json, so
+    // its validators no longer describe it.
+    remove_quietly(state_dir + "/repo.etag");
+    remove_quietly(state_dir + "/repo.source");
+    result.status = UpdateStatus::Updated;
+    result.source = base + "deltas (generation " + std::to_string(current) + " -> " + std::to_string(latest) + ")";
+    return result;
+}
+
+std::vector<std::string> candidate_urls(const std::string& url, const std::string& remembered) {
+    if (ends_with(url, ".zst") || ends_with(url, ".xz")) return {url};
+    std::vector<std::string> candidates;
+    if (!remembered.empty() && remembered.compare(0, url.size(), url) == 0) {
+        candidates.push_back(remembered);
+    }
+    for (const std::string& c : {url + ".zst", url + ".xz", url}) {
+        if (c != remembered) candidates.push_back(c);
+    }
+    return candidates;
+}
+
+} // namespace
+
+std::string shell_quote(const std::string& s) {
+    std::string quoted = "'";
+    for (char c : s) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += "'";
+    return quoted;
+}
+
+UpdateResult update_repo_file(const std::string& url, const std::string& repo_path,
+                              const std::string& state_dir) {
+    UpdateResult result;
+    std::filesystem::create_directories(state_dir);
+    std::filesystem::path repo_dir = std::filesystem::path(repo_path).parent_path();
+    if (!repo_dir.empty()) std::filesystem::create_directories(repo_dir);
+
+    const std::string etag_path = state_dir + "/repo.etag";
+    const std::string etag_new_path = etag_path + ".new";
+    const std::string source_path = state_dir + "/repo.source";
+    const std::string pid = std::to_string(getpid());
+    // Temporary files live next to repo.json so the final rename() never
+    // crosses a filesystem boundary.
+    const std::string download_path = repo_path + ".download." + pid;
+    const std::string staged_path = repo_path + ".new." + pid;
+
+    bool have_repo = std::filesystem::exists(repo_path);
+    if (have_repo) {
+        UpdateResult delta = update_from_deltas(url, repo_path, state_dir);
+        if (delta.status != UpdateStatus::Failed) return delta;
+    }
+    std::string remembered = read_line(source_path);
+
+    std::string fetched;
+    for (const std::string& candidate : candidate_urls(url, remembered)) {
+        // Validators only apply to the variant they were obtained from.
+        bool conditional = have_repo && candidate == remembered;
+        std::string args = " --etag-save " + shell_quote(etag_new_path);
+        if (conditional) {
+            args += " -z " + shell_quote(repo_path);
+            if (std::filesystem::exists(etag_path)) args += " --etag-compare " + shell_quote(etag_path);
+        }
+
+        FetchResult fetch = curl_fetch(candidate, download_path, args);
+        // file:// has no 304: an unchanged file is simply not written.
+        bool skipped = conditional && fetch.ok() && !std::filesystem::exists(download_path);
+        if ((fetch.exit_code == 0 && fetch.http_code == "304") || skipped) {
+            if (std::filesystem::exists(etag_new_path)) std::filesystem::rename(etag_new_path, etag_path);
+            result.status = UpdateStatus::NotModified;
+            result.source = candidate;
+            return result;
+        }
+        if (!fetch.ok()) {
+            remove_quietly(etag_new_path);
+            if (fetch.missing()) continue;
+            result.error = fetch.describe(candidate);
+            return result;
+        }
+        fetched = candidate;
+        break;
+    }
+    if (fetched.empty()) {
+        result.error = "no repository index found at " + url;
+        return result;
+    }
+
+    if (ends_with(fetched, ".zst") || ends_with(fetched, ".xz")) {
+        std::string tool = ends_with(fetched, ".zst") ? "zstd -dqc " : "xz -dc ";
+        std::string cmd = tool + shell_quote(download_path) + " > " + shell_quote(staged_path);
+        std::string ignored;
+        if (run_capture(cmd, ignored) != 0) {
+            remove_quietly(download_path);
+            remove_quietly(staged_path);
+            remove_quietly(etag_new_path);
+            result.error = "failed to decompress " + fetched;
+            return result;
+        }
+        // Keep the server's Last-Modified for the next If-Modified-Since.
+        std::error_code ec;
+        std::filesystem::last_write_time(staged_path, std::filesystem::last_write_time(download_path), ec);
+        remove_quietly(download_path);
+    } else {
+        std::filesystem::rename(download_path, staged_path);
+    }
+
+    // Never replace a working repo.json with one fox cannot read.
+    {
+        RepoRecords check;
+        std::string error;
+        if (!load_repo_records(staged_path, check, &error)) {
+            remove_quietly(staged_path);
+            remove_quietly(etag_new_path);
+            result.error = "downloaded index is invalid: " + error;
+            return result;
+        }
+    }
+
+    if (std::rename(staged_path.c_str(), repo_path.c_str()) != 0) {
+        remove_quietly(staged_path);
+        remove_quietly(etag_new_path);
+        result.error = "cannot replace " + repo_path;
+        return result;
+    }
+    if (std::filesystem::exists(etag_new_path)) std::filesystem::rename(etag_new_path, etag_path);
+    std::ofstream(source_path) << fetched << std::endl;
+
+    result.status = UpdateStatus::Updated;
+    result.source = fetched;
+    return result;
+}
+
+UpdateResult update_contents_file(const std::string& url, const std::string& contents_path,
+                                  const std::string& state_dir) {
+    UpdateResult result;
+    const std::string base = repo_base_url(url);
+    if (base.empty()) {
+        result.status = UpdateStatus::NotModified;
+        return result;
+    }
+    std::filesystem::create_directories(state_dir);
+    std::filesystem::path dir = std::filesystem::path(contents_path).parent_path();
+    if (!dir.empty()) std::filesystem::create_directories(dir);
+
+    const std::string etag_path = state_dir + "/contents.etag";
+    const std::string etag_new_path = etag_path + ".new";
+    const std::string download_path = contents_path + ".download." + std::to_string(getpid());
+    std::string args = " --etag-save " + shell_quote(etag_new_path);
+    if (std::filesystem::exists(contents_path)) {
+        args += " -z " + shell_quote(contents_path);
+        if (std::filesystem::exists(etag_path)) args += " --etag-compare " + shell_quote(etag_path);
+    }
+
+    result.source = base + "contents.idx";
+    FetchResult fetch = curl_fetch(result.source, download_path, args);
+    bool skipped = fetch.ok() && !std::filesystem::exists(download_path);
+    if ((fetch.exit_code == 0 && fetch.http_code == "304") || skipped) {
+        if (std::filesystem::exists(etag_new_path)) std::filesystem::rename(etag_new_path, etag_path);
+        result.status = UpdateStatus::NotModified;
+        return result;
+    }
+    if (fetch.missing()) {
+        remove_quietly(etag_new_path);
+        remove_quietly(etag_path);
+        result.status = std::filesystem::exists(contents_path) ? UpdateStatus::Removed : UpdateStatus::NotModified;
+        remove_quietly(contents_path);
+        return result;
+    }
+    ContentsIndex check;
+    if (!fetch.ok() || !check.open(download_path)) {
+        remove_quietly(download_path);
+        remove_quietly(etag_new_path);
+        result.error = fetch.ok() ? "downloaded contents index is invalid" : fetch.describe(result.source);
+        return result;
+    }
+    check.close();
+    if (std::rename(download_path.c_str(), contents_path.c_str()) != 0) {
+        remove_quietly(download_path);
+        remove_quietly(etag_new_path);
+        result.error = "cannot replace " + contents_path;
+        return result;
+    }
+    if (std::filesystem::exists(etag_new_path)) std::filesystem::rename(etag_new_path, etag_path);
+    result.status = UpdateStatus::Updated;
+    return result;
+}
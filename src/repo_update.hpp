@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+
+// `fox update`: refresh the local repo.json from a remote URL.
+//
+// Fetches go through curl and are conditional: the ETag from the previous
+// fetch is sent as If-None-Match and the current repo.json's mtime (set from
+// the server's Last-Modified) as If-Modified-Since. Compressed transfers are
+// preferred: for a URL ending in repo.json, <url>.zst and <url>.xz are tried
+// before the plain file, and whichever variant answered is remembered for the
+// next run. The download is decompressed and validated next to repo.json and
+// then rename()d over it, so readers only ever see a complete file.
+//
+// Repositories that publish generations (see repo_delta.hpp) are checked
+// first: when the local repo.json is only a few generations behind, the
+// missing deltas are fetched and applied instead of the whole file.
+//
+// Any curl URL works, so a local `python3 -m http.server` or a file:// URL
+// can stand in for the real repository.
+
+// Removed: the repository no longer publishes the file and the local copy
+// was deleted (contents indexes only).
+enum class UpdateStatus { Updated, NotModified, Removed, Failed };
+
+struct UpdateResult {
+    UpdateStatus status = UpdateStatus::Failed;
+    std::string source;  // URL that was actually fetched
+    std::string error;
+};
+
+// state_dir holds the saved ETag and the remembered source variant.
+UpdateResult update_repo_file(const std::string& url, const std::string& repo_path,
+                              const std::string& state_dir);
+
+// Refresh contents_path from contents.idx next to the repo.json at url (see
+// repo_contents.hpp), conditionally like repo.json. When the repository
+// does not publish one, a local copy and its ETag are removed (Removed) so
+// lookups never answer from an index of an older generation; without a
+// local copy that is NotModified.
+UpdateResult update_contents_file(const std::string& url, const std::string& contents_path,
+                                  const std::string& state_dir);
+
+// Quote s for use as one word in a /bin/sh command line.
+std::string shell_quote(const std::string& s);
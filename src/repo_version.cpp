@@ -0,0 +1,143 @@
+#include "repo_version.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr char KEY_TILDE = 0x01;
+constexpr char KEY_END = 0x02;
+constexpr char KEY_ALPHA = 0x03;
+constexpr char KEY_NUMBER = 0x04;
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+// Numbers are compared by digit count first, then digit by digit. Counts
+// beyond 255 digits are clamped; no real version gets there.
+void append_number(std::string& key, std::string_view digits) {
+    std::size_t zeros = 0;
+    while (zeros < digits.size() && digits[zeros] == '0') ++zeros;
+    digits.remove_prefix(zeros);
+    key.push_back(KEY_NUMBER);
+    key.push_back(static_cast<char>(std::min<std::size_t>(digits.size(), 255)));
+    key.append(digits);
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && is_space(s.front())) s.remove_prefix(1);
+    while (!s.empty() && is_space(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+} // namespace
+
+std::size_t dependency_name_length(std::string_view dep) {
+    std::size_t n = dep.find_first_of("<>=!~ \t");
+    return n == std::string_view::npos ? dep.size() : n;
+}
+
+Constraint parse_constraint(std::string_view dependency) {
+    Constraint c;
+    c.name = dependency.substr(0, dependency_name_length(dependency));
+    std::string_view rest = trim(dependency.substr(c.name.size()));
+    if (rest.empty()) return c;
+
+    static constexpr std::pair<std::string_view, ConstraintOp> OPS[] = {
+        {"==", ConstraintOp::Eq}, {"!=", ConstraintOp::Ne}, {"<=", ConstraintOp::Le}, {">=", ConstraintOp::Ge},
+        {"=", ConstraintOp::Eq},  {"<", ConstraintOp::Lt},  {">", ConstraintOp::Gt},
+    };
+    c.op = ConstraintOp::Invalid;
+    for (const auto& [text, op] : OPS) {
+        if (rest.compare(0, text.size(), text) == 0) {
+            c.op = op;
+            rest.remove_prefix(text.size());
+            break;
+        }
+    }
+    c.version = trim(rest);
+    if (c.op == ConstraintOp::Invalid || c.version.empty() ||
+        std::any_of(c.version.begin(), c.version.end(), [](char ch) { return is_space(ch) || ch == '<' || ch == '>' || ch == '='; })) {
+        c.op = ConstraintOp::Invalid;
+    }
+    return c;
+}
+
+void split_alternatives(std::string_view dependency, std::vector<std::string_view>& out) {
+    out.clear();
+    while (true) {
+        std::size_t bar = dependency.find('|');
+        std::string_view alternative = trim(dependency.substr(0, bar));
+        if (!alternative.empty()) out.push_back(alternative);
+        if (bar == std::string_view::npos) return;
+        dependency.remove_prefix(bar + 1);
+    }
+}
+
+std::string version_key(std::string_view version) {
+    std::string key;
+    key.reserve(version.size() + 8);
+    std::size_t colon = version.find(':');
+    if (colon != std::string_view::npos && colon > 0 &&
+        std::all_of(version.begin(), version.begin() + colon, is_digit)) {
+        append_number(key, version.substr(0, colon));
+        version.remove_prefix(colon + 1);
+    } else {
+        append_number(key, "0");
+    }
+    std::size_t i = 0;
+    while (i < version.size()) {
+        char c = version[i];
+        if (c == '~') {
+            key.push_back(KEY_TILDE);
+            ++i;
+        } else if (is_digit(c)) {
+            std::size_t end = i;
+            while (end < version.size() && is_digit(version[end])) ++end;
+            append_number(key, version.substr(i, end - i));
+            i = end;
+        } else if (is_alpha(c)) {
+            std::size_t end = i;
+            while (end < version.size() && is_alpha(version[end])) ++end;
+            key.push_back(KEY_ALPHA);
+            key.append(version.substr(i, end - i));
+            key.push_back('\0');
+            i = end;
+        } else {
+            ++i;
+        }
+    }
+    key.push_back(KEY_END);
+    return key;
+}
+
+bool version_satisfies(std::string_view key, ConstraintOp op, std::string_view constraint_key) {
+    if (op == ConstraintOp::Any) return true;
+    if (op == ConstraintOp::Invalid) return false;
+    int order = key.compare(constraint_key);
+    switch (op) {
+        case ConstraintOp::Eq: return order == 0;
+        case ConstraintOp::Ne: return order != 0;
+        case ConstraintOp::Lt: return order < 0;
+        case ConstraintOp::Le: return order <= 0;
+        case ConstraintOp::Gt: return order > 0;
+        case ConstraintOp::Ge: return order >= 0;
+        default: return false;
+    }
+}
+
+int compare_versions(std::string_view a, std::string_view b) {
+    return version_key(a).compare(version_key(b));
+}
+
+const char* constraint_op_text(ConstraintOp op) {
+    switch (op) {
+        case ConstraintOp::Eq: return "==";
+        case ConstraintOp::Ne: return "!=";
+        case ConstraintOp::Lt: return "<";
+        case ConstraintOp::Le: return "<=";
+        case ConstraintOp::Gt: return ">";
+        case ConstraintOp::Ge: return ">=";
+        default: return "";
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Versions and dependency constraints.
+//
+// A dependency is a package name optionally followed by an operator and a
+// version: "glibc>=2.31", "another-package==1.0.0", "zlib < 2". Constraints
+// are parsed once, when the index is built, and every version is stored as a
+// sort key whose byte order is the version order, so checking a constraint
+// is a single memcmp.
+//
+// Versions compare segment by segment. Runs of digits are numbers (leading
+// zeros do not count, so 1.02 == 1.2 and 1.10 > 1.9), runs of letters
+// compare as text, and any other character only separates segments. A
+// letter segment sorts before a number in the same position (1.0a < 1.0.1),
+// and a version that runs out of segments sorts before one that continues
+// (1.0 < 1.0a < 1.0.0), except after '~', which sorts before everything,
+// including the end (1.0~rc1 < 1.0). An "epoch:" prefix outranks the rest.
+//
+// Key layout, per segment: '~' is 0x01; a number is 0x04, the digit count
+// and the digits; a letter run is 0x03, the letters and 0x00. The key ends
+// with 0x02 and starts with the epoch as a number.
+
+enum class ConstraintOp : uint32_t { Any, Eq, Ne, Lt, Le, Gt, Ge, Invalid };
+
+struct Constraint {
+    std::string_view name;
+    ConstraintOp op = ConstraintOp::Any;
+    std::string_view version;  // empty for Any
+};
+
+// Length of the package-name prefix of a dependency string: everything up to
+// the first version operator or whitespace.
+std::size_t dependency_name_length(std::string_view dep);
+
+// Split a dependency string into name, operator and version. Operators are
+// =, ==, !=, <, <=, > and >=, with optional whitespace around them. Anything
+// else after the name makes the constraint Invalid, which nothing satisfies.
+Constraint parse_constraint(std::string_view dependency);
+
+// The alternatives of a dependency such as "mta | sendmail>=8", trimmed;
+// empty ones are dropped.
+void split_alternatives(std::string_view dependency, std::vector<std::string_view>& out);
+
+// Byte-comparable sort key of a version.
+std::string version_key(std::string_view version);
+
+// Whether a version with sort key key meets op against constraint_key.
+bool version_satisfies(std::string_view key, ConstraintOp op, std::string_view constraint_key);
+
+// <0, 0 or >0 as version a sorts before, with or after version b.
+int compare_versions(std::string_view a, std::string_view b);
+
+// Operator as written in a dependency, e.g. ">=".
+const char* constraint_op_text(ConstraintOp op);
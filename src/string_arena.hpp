@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Bump allocator for string data. Strings are copied into large chunks and
+// stay put until the arena is destroyed; nothing is freed individually, so a
+// whole repository's worth of metadata costs a handful of allocations.
+class StringArena {
+public:
+    explicit StringArena(std::size_t chunk_size = 64 * 1024) : chunk_size_(chunk_size) {}
+
+    std::string_view store(std::string_view s) {
+        if (s.empty()) return std::string_view();
+        char* dst = allocate(s.size());
+        std::memcpy(dst, s.data(), s.size());
+        return std::string_view(dst, s.size());
+    }
+
+    std::size_t bytes_used() const { return used_; }
+
+private:
+    char* allocate(std::size_t n) {
+        if (n > left_) {
+            // Oversized strings get a dedicated chunk so the current one keeps
+            // its remaining space.
+            std::size_t size = n > chunk_size_ / 4 ? n : chunk_size_;
+            chunks_.emplace_back(new char[size]);
+            if (size == n) {
+                used_ += n;
+                return chunks_.back().get();
+            }
+            cur_ = chunks_.back().get();
+            left_ = size;
+        }
+        char* p = cur_;
+        cur_ += n;
+        left_ -= n;
+        used_ += n;
+        return p;
+    }
+
+    std::size_t chunk_size_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* cur_ = nullptr;
+    std::size_t left_ = 0;
+    std::size_t used_ = 0;
+};
+
+// Assigns each distinct string a dense id. The text lives in an arena, so
+// views returned by str() stay valid for the interner's lifetime.
+class StringInterner {
+public:
+    uint32_t intern(std::string_view s) {
+        auto it = ids_.find(s);
+        if (it != ids_.end()) return it->second;
+        std::string_view stored = arena_.store(s);
+        uint32_t id = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(stored);
+        ids_.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view str(uint32_t id) const { return strings_[id]; }
+    uint32_t size() const { return static_cast<uint32_t>(strings_.size()); }
+    std::size_t total_bytes() const { return arena_.bytes_used(); }
+
+private:
+    StringArena arena_;
+    std::vector<std::string_view> strings_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
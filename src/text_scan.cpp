@@ -0,0 +1,114 @@
+#include "text_scan.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FOX_TEXT_X86 1
+#endif
+
+namespace {
+
+constexpr std::size_t npos = std::string_view::npos;
+
+inline unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+// Compare n bytes of text against an already folded needle.
+inline bool equal_folded(const char* text, const char* needle, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        if (fold(static_cast<unsigned char>(text[i])) != static_cast<unsigned char>(needle[i])) return false;
+    }
+    return true;
+}
+
+std::size_t find_scalar(std::string_view haystack, std::string_view needle, bool ignore_case, std::size_t from) {
+    if (!ignore_case) return haystack.find(needle, from);
+    const unsigned char first = static_cast<unsigned char>(needle[0]);
+    for (std::size_t i = from; i + needle.size() <= haystack.size(); ++i) {
+        if (fold(static_cast<unsigned char>(haystack[i])) == first &&
+            equal_folded(haystack.data() + i + 1, needle.data() + 1, needle.size() - 1)) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+#ifdef FOX_TEXT_X86
+__attribute__((target("avx2")))
+inline __m256i fold_avx2(__m256i v) {
+    // Signed compares: bytes >= 0x80 are negative and never count as upper case.
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+std::size_t find_avx2(std::string_view haystack, std::string_view needle, bool ignore_case) {
+    const std::size_t n = needle.size();
+    const char* h = haystack.data();
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[n - 1]);
+    std::size_t i = 0;
+    for (; i + n - 1 + 32 <= haystack.size(); i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i + n - 1));
+        if (ignore_case) {
+            a = fold_avx2(a);
+            b = fold_avx2(b);
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        while (mask) {
+            std::size_t at = i + static_cast<std::size_t>(__builtin_ctz(mask));
+            bool match = n <= 2 || (ignore_case ? equal_folded(h + at + 1, needle.data() + 1, n - 2)
+                                                : std::memcmp(h + at + 1, needle.data() + 1, n - 2) == 0);
+            if (match) return at;
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(haystack, needle, ignore_case, i);
+}
+#endif
+
+using FindFn = std::size_t (*)(std::string_view, std::string_view, bool);
+
+struct Kernel {
+    FindFn find;
+    const char* name;
+};
+
+std::size_t find_scalar_from_start(std::string_view haystack, std::string_view needle, bool ignore_case) {
+    return find_scalar(haystack, needle, ignore_case, 0);
+}
+
+Kernel select_kernel() {
+#ifdef FOX_TEXT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {find_avx2, "avx2"};
+#endif
+    return {find_scalar_from_start, "scalar"};
+}
+
+const Kernel& kernel() {
+    static const Kernel k = select_kernel();
+    return k;
+}
+
+} // namespace
+
+std::size_t find_text(std::string_view haystack, std::string_view needle, bool ignore_case) {
+    if (needle.empty()) return 0;
+    if (needle.size() > haystack.size()) return npos;
+    if (!ignore_case) return kernel().find(haystack, needle, false);
+    std::string folded(needle);
+    for (char& c : folded) c = static_cast<char>(fold(static_cast<unsigned char>(c)));
+    return kernel().find(haystack, folded, true);
+}
+
+const char* text_scanner_name() {
+    return kernel().name;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Substring search over large in-memory text.
+//
+// The AVX2 kernel compares the needle's first and last byte against 32
+// candidate positions at once and only verifies the positions where both
+// match; with ignore_case both sides are folded to lower case (ASCII only)
+// inside the vector registers first. Other CPUs use a scalar loop.
+
+// Offset of the first occurrence of needle in haystack, or
+// std::string_view::npos.
+std::size_t find_text(std::string_view haystack, std::string_view needle, bool ignore_case);
+
+// Name of the kernel picked for this CPU: "avx2" or "scalar".
+const char* text_scanner_name();
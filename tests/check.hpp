@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertions for the test programs: CHECK reports a failed condition
+// with its location and counts it, and main returns check_failures() so
+// ctest sees the failure.
+
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                           \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++check_failures();                                                    \
+        }                                                                          \
+    } while (0)
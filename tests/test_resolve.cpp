@@ -0,0 +1,154 @@
+// Install planning on small hand-written repositories: explanations must be
+// exactly the rules that cannot all hold, and provided names must be met by
+// their providers.
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "repo_index.hpp"
+#include "repo_resolve.hpp"
+#include "repo_scan.hpp"
+
+namespace {
+
+using Installed = std::map<std::string, std::string, std::less<>>;
+
+// Index repo_json in a fresh directory under the system temp directory.
+class TestRepo {
+public:
+    explicit TestRepo(const std::string& repo_json) {
+        std::string pattern = (std::filesystem::temp_directory_path() / "fox-test-XXXXXX").string();
+        if (mkdtemp(pattern.data())) dir_ = pattern;
+        CHECK(!dir_.empty());
+        CHECK(scan_repo_json(json_ = repo_json, records_));
+        CHECK(build_repo_index(records_, dir_ + "/repo.idx", "main"));
+        CHECK(index_.open(dir_ + "/repo.idx"));
+    }
+    ~TestRepo() {
+        index_.close();
+        std::error_code ec;
+        if (!dir_.empty()) std::filesystem::remove_all(dir_, ec);
+    }
+
+    InstallPlan resolve(const std::vector<std::string>& names, const Installed& installed = {}) const {
+        std::vector<uint32_t> requested;
+        for (const std::string& name : names) requested.push_back(index_.find(name));
+        std::vector<uint32_t> installed_ids;
+        for (const auto& entry : installed) {
+            uint32_t id = index_.find(entry.first);
+            if (id != REPO_INDEX_NPOS) installed_ids.push_back(id);
+        }
+        auto satisfies = [&installed](const DependencyView& dep) {
+            auto it = installed.find(dep.name);
+            return it != installed.end() && dep.satisfied_by(version_key(it->second));
+        };
+        InstallPlan plan;
+        resolve_install(index_, requested, satisfies, installed_ids, plan);
+        return plan;
+    }
+
+    std::vector<std::string> names(const std::vector<uint32_t>& ids) const {
+        std::vector<std::string> out;
+        for (uint32_t id : ids) out.emplace_back(index_.name(id));
+        return out;
+    }
+
+private:
+    std::string dir_;
+    std::string json_;
+    RepoRecords records_;
+    RepoIndex index_;
+};
+
+std::vector<std::string> sorted(std::vector<std::string> lines) {
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+// Rules that play no part in the problem (e, f) must be left out.
+void check_minimal_explanation() {
+    TestRepo repo(R"({"packages": {
+        "a": {"version": "1", "dependencies": ["b | c", "d", "e"]},
+        "b": {"version": "1", "conflicts": ["d"]},
+        "c": {"version": "1", "conflicts": ["d"]},
+        "d": {"version": "1"},
+        "e": {"version": "1", "dependencies": ["f"]},
+        "f": {"version": "1"}
+    }})");
+    InstallPlan plan = repo.resolve({"a"});
+    CHECK(plan.packages.empty());
+    CHECK(plan.problems.size() == 1);
+    if (plan.problems.size() != 1) return;
+    CHECK(plan.problems[0].package == "a");
+    CHECK(sorted(plan.problems[0].explanation) == sorted({"a was requested", "a needs b | c", "a needs d",
+                                                          "b conflicts with d", "c conflicts with d"}));
+}
+
+void check_version_explanation() {
+    TestRepo repo(R"({"packages": {
+        "a": {"version": "1", "dependencies": ["b"]},
+        "b": {"version": "1", "dependencies": ["c>=2", "d"]},
+        "c": {"version": "1.9"},
+        "d": {"version": "1"}
+    }})");
+    InstallPlan plan = repo.resolve({"a"});
+    CHECK(plan.problems.size() == 1);
+    if (plan.problems.size() != 1) return;
+    CHECK(plan.problems[0].message == "b needs c>=2, but only c 1.9 is available");
+    CHECK(sorted(plan.problems[0].explanation) ==
+          sorted({"a was requested", "a needs b", "b needs c>=2, but only c 1.9 is available"}));
+}
+
+// Of two requests that conflict, the later one is left out and the earlier
+// one is still planned.
+void check_conflicting_requests() {
+    TestRepo repo(R"({"packages": {
+        "x": {"version": "1", "conflicts": ["y"]},
+        "y": {"version": "1"}
+    }})");
+    InstallPlan plan = repo.resolve({"x", "y"});
+    CHECK(repo.names(plan.packages) == std::vector<std::string>{"x"});
+    CHECK(plan.problems.size() == 1);
+    if (plan.problems.size() != 1) return;
+    CHECK(plan.problems[0].package == "y");
+    CHECK(sorted(plan.problems[0].explanation) == sorted({"x was requested", "y was requested", "x conflicts with y"}));
+}
+
+void check_provides() {
+    TestRepo repo(R"({"packages": {
+        "mailer": {"version": "1", "dependencies": ["mta"]},
+        "versioned": {"version": "1", "dependencies": ["mta>=2"]},
+        "postfix": {"version": "3", "provides": ["mta"], "conflicts": ["mta"]},
+        "exim": {"version": "4", "provides": ["mta"], "conflicts": ["mta"]}
+    }})");
+    // Any one provider will do, and the first in name order is preferred.
+    InstallPlan plan = repo.resolve({"mailer"});
+    CHECK(plan.problems.empty());
+    CHECK(repo.names(plan.packages) == (std::vector<std::string>{"exim", "mailer"}));
+    // An installed provider meets the dependency.
+    plan = repo.resolve({"mailer"}, {{"postfix", "3"}});
+    CHECK(repo.names(plan.packages) == std::vector<std::string>{"mailer"});
+    // A conflict on the provided name covers the other providers only.
+    plan = repo.resolve({"exim"}, {{"postfix", "3"}});
+    CHECK(plan.packages.empty());
+    CHECK(plan.problems.size() == 1);
+    // Provided names have no version.
+    plan = repo.resolve({"versioned"});
+    CHECK(plan.packages.empty());
+    CHECK(plan.problems.size() == 1);
+}
+
+} // namespace
+
+int main() {
+    check_minimal_explanation();
+    check_version_explanation();
+    check_conflicting_requests();
+    check_provides();
+    return check_failures() != 0;
+}
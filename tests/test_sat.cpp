@@ -0,0 +1,106 @@
+// SatSolver against brute force on random small CNFs: the answer must match,
+// a model must satisfy every clause and assumption, and failed assumptions
+// must be a subset of the assumptions that cannot hold on their own.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "repo_sat.hpp"
+
+namespace {
+
+using Clauses = std::vector<std::vector<SatLiteral>>;
+
+bool holds(SatLiteral literal, uint32_t assignment) {
+    bool value = (assignment >> sat_variable(literal)) & 1;
+    return (literal & 1) ? !value : value;
+}
+
+// Whether some assignment of n variables satisfies clauses and assumptions.
+bool brute_force(uint32_t n, const Clauses& clauses, const std::vector<SatLiteral>& assumptions) {
+    for (uint32_t assignment = 0; assignment < (1u << n); ++assignment) {
+        auto satisfied = [assignment](const std::vector<SatLiteral>& clause) {
+            return std::any_of(clause.begin(), clause.end(), [assignment](SatLiteral l) { return holds(l, assignment); });
+        };
+        bool assumed = std::all_of(assumptions.begin(), assumptions.end(),
+                                   [assignment](SatLiteral a) { return holds(a, assignment); });
+        if (assumed && std::all_of(clauses.begin(), clauses.end(), satisfied)) return true;
+    }
+    return false;
+}
+
+std::vector<SatLiteral> random_literals(std::mt19937& rng, uint32_t n, uint32_t count) {
+    std::vector<SatLiteral> literals;
+    for (uint32_t i = 0; i < count; ++i) literals.push_back(sat_literal(rng() % n, rng() % 2));
+    return literals;
+}
+
+void check_random_cnfs() {
+    std::mt19937 rng(1);
+    for (int round = 0; round < 2000; ++round) {
+        uint32_t n = 2 + rng() % 10;
+        Clauses clauses;
+        for (uint32_t m = 1 + rng() % 40; m > 0; --m) clauses.push_back(random_literals(rng, n, 1 + rng() % 3));
+        SatSolver solver;
+        for (uint32_t v = 0; v < n; ++v) solver.add_variable(rng() % 2);
+        for (const auto& clause : clauses) solver.add_clause(clause);
+
+        // Several calls on one solver, so learned clauses carry over.
+        for (int call = 0; call < 3; ++call) {
+            std::vector<SatLiteral> assumptions = random_literals(rng, n, rng() % 4);
+            bool sat = solver.solve(assumptions);
+            bool expected = brute_force(n, clauses, assumptions);
+            CHECK(sat == expected);
+            if (sat != expected) continue;
+            if (sat) {
+                uint32_t model = 0;
+                for (uint32_t v = 0; v < n; ++v) model |= uint32_t(solver.value(v)) << v;
+                for (SatLiteral a : assumptions) CHECK(holds(a, model));
+                for (const auto& clause : clauses) {
+                    bool satisfied = false;
+                    for (SatLiteral l : clause) satisfied = satisfied || holds(l, model);
+                    CHECK(satisfied);
+                }
+            } else {
+                const std::vector<SatLiteral>& failed = solver.failed_assumptions();
+                CHECK(!brute_force(n, clauses, failed));
+                for (SatLiteral l : failed) {
+                    bool assumed = false;
+                    for (SatLiteral a : assumptions) assumed = assumed || a == l;
+                    CHECK(assumed);
+                }
+            }
+        }
+    }
+}
+
+// Seven pigeons do not fit in six holes.
+void check_pigeonhole() {
+    const uint32_t pigeons = 7, holes = 6;
+    SatSolver solver;
+    for (uint32_t v = 0; v < pigeons * holes; ++v) solver.add_variable(false);
+    for (uint32_t p = 0; p < pigeons; ++p) {
+        std::vector<SatLiteral> somewhere;
+        for (uint32_t h = 0; h < holes; ++h) somewhere.push_back(sat_literal(p * holes + h, true));
+        solver.add_clause(somewhere);
+    }
+    for (uint32_t h = 0; h < holes; ++h) {
+        for (uint32_t p = 0; p < pigeons; ++p) {
+            for (uint32_t q = p + 1; q < pigeons; ++q) {
+                solver.add_clause({sat_literal(p * holes + h, false), sat_literal(q * holes + h, false)});
+            }
+        }
+    }
+    CHECK(!solver.solve());
+    CHECK(solver.failed_assumptions().empty());
+}
+
+} // namespace
+
+int main() {
+    check_random_cnfs();
+    check_pigeonhole();
+    return check_failures() != 0;
+}
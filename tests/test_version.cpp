@@ -0,0 +1,68 @@
+// Version sort keys: every pair must compare the same way through
+// compare_versions() and through the bytes of version_key().
+
+#include <string>
+
+#include "check.hpp"
+#include "repo_version.hpp"
+
+namespace {
+
+int sign(int value) { return (value > 0) - (value < 0); }
+
+// expected is <0, 0 or >0 as a sorts before, with or after b.
+void check_order(const char* a, const char* b, int expected) {
+    int by_compare = sign(compare_versions(a, b));
+    int by_key = sign(version_key(a).compare(version_key(b)));
+    if (by_compare != expected || by_key != expected) {
+        std::fprintf(stderr, "%s vs %s: expected %d, compare_versions %d, version_key %d\n", a, b, expected,
+                     by_compare, by_key);
+        ++check_failures();
+    }
+    // The reverse pair must agree.
+    CHECK(sign(compare_versions(b, a)) == -expected);
+}
+
+} // namespace
+
+int main() {
+    // Numbers compare numerically; leading zeros do not count.
+    check_order("1.10", "1.9", 1);
+    check_order("1.02", "1.2", 0);
+    check_order("1.002", "1.1", 1);
+    check_order("007", "7", 0);
+    check_order("2", "10", -1);
+    check_order("1.0", "1.0.0", -1);
+
+    // Letters compare as text and sort before a number in the same position.
+    check_order("1.0a", "1.0.1", -1);
+    check_order("1.0", "1.0a", -1);
+    check_order("1.0a", "1.0b", -1);
+    check_order("1.a", "1.0", -1);
+    check_order("1.0alpha", "1.0beta", -1);
+
+    // ~ sorts before everything, even the end of the version.
+    check_order("1.0~rc1", "1.0", -1);
+    check_order("1.0~rc1", "1.0~rc2", -1);
+    check_order("1.0~~", "1.0~", -1);
+    check_order("1.0~rc1", "1.0a", -1);
+
+    // An epoch outranks the rest; a missing one is 0.
+    check_order("1:0.1", "9.9", 1);
+    check_order("0:1.0", "1.0", 0);
+    check_order("2:1.0", "10:0.1", -1);
+    check_order("1:1.0~rc1", "1:1.0", -1);
+
+    // Constraints go through the same keys.
+    CHECK(version_satisfies(version_key("1.10"), ConstraintOp::Ge, version_key("1.9")));
+    CHECK(version_satisfies(version_key("1.02"), ConstraintOp::Eq, version_key("1.2")));
+    CHECK(!version_satisfies(version_key("1.0~rc1"), ConstraintOp::Ge, version_key("1.0")));
+    CHECK(version_satisfies(version_key("1.0"), ConstraintOp::Ne, version_key("1.0.0")));
+
+    Constraint constraint = parse_constraint("glibc >= 2.31");
+    CHECK(constraint.name == "glibc");
+    CHECK(constraint.op == ConstraintOp::Ge);
+    CHECK(constraint.version == "2.31");
+    CHECK(parse_constraint("glibc 2.31").op == ConstraintOp::Invalid);
+    return check_failures() != 0;
+}